@@ -39,9 +39,14 @@ protected:
 		this->gf = &gf;
 		this->n = gf.GetN();
 		this->m = gf.GetN();
+		random.Seed(MIRandom::StreamSeed(MIRandom::CASCADE_STREAMS, streamKey));
 	}
 public:
-	CascadeT() : gf(NULL) {}
+	/// key of the random stream of the cascade, seeded by Build. Cascades of one run that
+	/// should draw independently under a fixed --seed need different keys
+	unsigned long long streamKey;
+
+	CascadeT() : gf(NULL), streamKey(0) {}
 };
 
 
@@ -3,6 +3,7 @@
 
 
 #include "cascade.h"
+#include "mi_scratch.h"
 #include "cstring"
 
 /// Template class that implements general cascade diffusion
@@ -12,9 +13,20 @@ class GeneralCascadeT:
 {
 public:
 	int nthreads;
+	/// simulate the iterations of Run in bit-parallel batches of BATCH_SIZE worlds (see RunBatch)
+	bool isBatchRun;
+
+	/// Number of worlds RunBatch simulates together, one bit of a word each
+	static const int BATCH_SIZE = 64;
+	/// Number of iterations drawn from one RNG stream (independent of the thread count), one batch
+	static const int RUN_BLOCK_SIZE = BATCH_SIZE;
+
+protected:
+	/// whether InitializeConcurrent has set up the threads already
+	bool isConcurrencyInitialized;
 
 public:
-	GeneralCascadeT() : nthreads(16) {}
+	GeneralCascadeT() : nthreads(16) , isBatchRun(false), isConcurrencyInitialized(false) {}
 
 	virtual void Build(TGraph& gf)
 	{
@@ -33,13 +45,91 @@ public:
 		return _Run(num_iter, size, set, active);
 	}
 
+	/// Simulate count (<= BATCH_SIZE) worlds from the seeds set[0 ... size) in one bit-parallel traversal:
+	/// outWorlds[v] gets the worlds in which v is activated, bit i for world i.
+	/// Returns the number of activations over all the worlds
+	long long RunBatch(int count, int size, int set[], std::vector<uint64_t>& outWorlds)
+	{
+		if (this->gf == NULL) {
+			throw NullPointerException("Please Build Graph first. (gf==NULL)");
+		}
+		MIRandom random(MIRandom::StreamSeed(_NextRunKey()));
+		BatchTraversalScratch& scratch = _ThreadBatchScratch();
+		long long result = _RunBatch(random, count, size, set, scratch);
+		outWorlds.assign(this->n, 0);
+		for (int v : scratch.touched) outWorlds[v] = scratch.reached[v];
+		return result;
+	}
+
+
+	/// Average number of activated nodes of every prefix set[0 ... t], t < size, over num_iter iterations:
+	/// the spreads Run gives for the sizes 1 ... size, with a single traversal of every world.
+	/// The blocks are drawn and spread over the threads as in Run
+	std::vector<double> RunPrefixes(int num_iter, int size, int set[])
+	{
+		InitializeConcurrent();
+		if (this->gf == NULL) {
+			throw NullPointerException("Please Build Graph first. (gf==NULL)");
+		}
+
+		unsigned long long runKey = _NextRunKey();
+		int nBlocks = (num_iter + RUN_BLOCK_SIZE - 1) / RUN_BLOCK_SIZE;
+		std::vector<long long> counts(size, 0);
+
+		// every thread sums its blocks on its own, the sums are added up at the end
+#pragma omp parallel if(IsConcurrent() && nBlocks > 1)
+		{
+			std::vector<long long> local(size, 0);
+#pragma omp for schedule(dynamic)
+			for (int b = 0; b < nBlocks; b++) {
+				_RunPrefixBlock(runKey, b, num_iter, size, set, local.data());
+			}
+#pragma omp critical(general_cascade_prefixes)
+			for (int t = 0; t < size; t++) {
+				counts[t] += local[t];
+			}
+		}
+
+		std::vector<double> spreads(size);
+		for (int t = 0; t < size; t++) {
+			spreads[t] = (double)counts[t] / (double)num_iter;
+		}
+		return spreads;
+	}
+
+	/// Key of a new run of RunPrefixBlocks, drawn from the generator of the cascade
+	unsigned long long NewRunKey()
+	{
+		return _NextRunKey();
+	}
+
+	/// Activations of every prefix set[0 ... t], t < size, in each of the blocks first ... first + count - 1
+	/// of the run keyed runKey: outSums[b * size + t] for block first + b. The blocks are RUN_BLOCK_SIZE
+	/// iterations drawn as in RunPrefixes, so a run may be extended block by block and stays reproducible
+	void RunPrefixBlocks(unsigned long long runKey, int first, int count, int size, int set[], std::vector<long long>& outSums)
+	{
+		InitializeConcurrent();
+		if (this->gf == NULL) {
+			throw NullPointerException("Please Build Graph first. (gf==NULL)");
+		}
+
+		int num_iter = (first + count) * RUN_BLOCK_SIZE;
+		outSums.assign((size_t)count * size, 0);
+#pragma omp parallel for schedule(dynamic) if(IsConcurrent() && count > 1)
+		for (int b = 0; b < count; b++) {
+			_RunPrefixBlock(runKey, first + b, num_iter, size, set, outSums.data() + (size_t)b * size);
+		}
+	}
 
 protected:
+	/// Set up the omp threads before the first run. A Run from inside a parallel region, e.g. from a worker
+	/// of a caller spreading candidates over the threads, leaves the settings of the caller alone
 	void InitializeConcurrent() 
 	{
-		if (IsConcurrent())
+		if (IsConcurrent() && !isConcurrencyInitialized)
 		{
 #ifdef MI_USE_OMP
+			if (omp_in_parallel()) return;
 			/////////////////////////////////////////////
 			// run concurrently
 			const double DYNAMIC_RATIO = 0.25;
@@ -52,6 +142,7 @@ protected:
 #else
 			std::cout << "== omp is not supported or enabled == " << std::endl;
 #endif
+			isConcurrencyInitialized = true;
 		}
 	}
 
@@ -60,112 +151,194 @@ protected:
 		return (nthreads > 1);
 	}
 
-	double _Run(int num_iter, int size, int set[]) 
+	/// Working space of the calling thread. It is kept per thread rather than per cascade,
+	/// so that one cascade may also be run from several threads at once
+	static TraversalScratch& _ThreadScratch()
 	{
-		// MI_STATIC_ASSERT(has_mem_GetNeighborCount<TGraph>::value, "TGraph should has member GetNeighborCount");
-		// MI_STATIC_ASSERT(has_mem_GetEdge<TGraph>::value, "TGraph should has member GetEdge");
-		// MI_STATIC_ASSERT(has_mem_edgeForm<TGraph>::value, "TGraph should has member edgeForm");
+		static thread_local TraversalScratch scratch;
+		return scratch;
+	}
 
-		if (this->gf == NULL) {
-			throw NullPointerException("Please Build Graph first. (gf==NULL)");
-		}
-		
-		int targetSize = size;
-		int resultSize = 0;
-		ProbTransfom trans(this->gf->edgeForm);
+	static BatchTraversalScratch& _ThreadBatchScratch()
+	{
+		static thread_local BatchTraversalScratch scratch;
+		return scratch;
+	}
 
-#ifdef MI_USE_OMP
-		if (!IsConcurrent()) {
-#endif
-			// single thread
-			int* list = new int[this->n];
-			bool* active = new bool[this->n];
-			for (int it = 0; it < num_iter; it++)
-			{
-				memset(active, 0, sizeof(bool)*(this->n));
-				for (int i = 0; i < targetSize; i++)
-				{
-					list[i] = set[i];
-					active[list[i]] = true;
-				}
-				resultSize += targetSize;
+	/// Key of the RNG streams of the next run, drawn from the generator of the cascade
+	unsigned long long _NextRunKey()
+	{
+		unsigned long long key;
+#pragma omp critical(general_cascade_run_key)
+		key = this->random.RandSeed();
+		return key;
+	}
 
-				int h = 0;
-				int t = targetSize;
+	/// Expand the queued nodes from position h on, flipping the coins of their out-edges once,
+	/// until the queue is drained. Returns the number of nodes activated
+	long long _Expand(MIRandom& random, TraversalScratch& scratch, size_t& h)
+	{
+		std::vector<int>& list = scratch.queue;
+		long long result = 0;
+		for (; h < list.size(); h++)
+		{
+			int k = this->gf->GetNeighborCount(list[h]);
+			for (int i = 0; i < k; i++)
+			{
+				auto& e = this->gf->GetEdge(list[h], i);
+				if (scratch.IsVisited(e.v)) continue;
 
-				while (h < t)
+				if (random.RandAccept(e.th1))
 				{
-					int k = this->gf->GetNeighborCount(list[h]);
-					//printf("%d \n",k);
-					for (int i = 0; i < k; i++)
-					{
-						auto& e = this->gf->GetEdge(list[h], i);
-						if (active[e.v]) continue;
-
-						if ((this->random).RandBernoulli(trans.Prob(e.w1)))
-						{
-							list[t] = e.v;
-							active[e.v] = true;
-							t++;
-							resultSize++;
-							//break;
-						}
-					}
-					h++;
+					list.push_back(e.v);
+					scratch.Visit(e.v);
+					result++;
 				}
 			}
+		}
+		return result;
+	}
 
-			SAFE_DELETE_ARRAY(active);
-			SAFE_DELETE_ARRAY(list);
-
-#ifdef MI_USE_OMP
-		} else {
-			// concurrent
-
-			#pragma omp parallel for
-			for (int it = 0; it < num_iter; it++) {
-				std::vector<int> list(this->n);
-				std::vector<bool> active(this->n, false);
-				for (int i = 0; i < targetSize; i++)
-				{
-					list[i] = set[i];
-					active[list[i]] = true;
+	/// Bit-parallel _Expand: every node carries the mask of the worlds it is active in, and an edge is
+	/// flipped for the worlds where its source is active and its target not yet. The worlds share the
+	/// reads of the adjacency lists. Returns the number of activations over all the worlds
+	long long _ExpandBatch(MIRandom& random, BatchTraversalScratch& scratch, size_t& h)
+	{
+		long long result = 0;
+		for (; h < scratch.queue.size(); h++)
+		{
+			int u = scratch.queue[h];
+			uint64_t mask = scratch.pending[u];
+			scratch.pending[u] = 0;
+			int k = this->gf->GetNeighborCount(u);
+			for (int i = 0; i < k; i++)
+			{
+				auto& e = this->gf->GetEdge(u, i);
+				uint64_t candidates = mask & ~scratch.reached[e.v];
+				uint64_t hits = 0;
+				for (uint64_t bits = candidates; bits != 0; bits &= bits - 1) {
+					if (random.RandAccept(e.th1)) hits |= 1ULL << LowestBitIndex(bits);
 				}
-				int curResult = targetSize;
-				int h = 0;
-				int t = targetSize;
-				
-				while (h < t)
-				{
-					int k = this->gf->GetNeighborCount(list[h]);
-					//printf("%d \n",k);
-					for (int i = 0; i < k; i++)
-					{
-						auto& e = this->gf->GetEdge(list[h], i);
-						if (active[e.v]) continue;
-
-						if ((this->random).RandBernoulli(trans.Prob(e.w1)))
-						{
-							list[t] = e.v;
-							active[e.v] = true;
-							t++;
-							curResult++;
-						}
-					}
-					h++;
+				if (hits != 0) {
+					scratch.Reach(e.v, hits);
+					result += BitCount(hits);
 				}
+			}
+		}
+		return result;
+	}
 
-				#pragma omp atomic
-				resultSize += curResult;
+	/// mask of the worlds 0 ... count-1
+	static uint64_t _Worlds(int count)
+	{
+		assert(count > 0 && count <= BATCH_SIZE);
+		return (count == BATCH_SIZE) ? ~0ULL : (1ULL << count) - 1;
+	}
+
+	/// Simulate the iterations of one block from its own stream MIRandom::StreamSeed(runKey, block),
+	/// one by one or as the worlds of one batch if isBatchRun.
+	/// Returns the number of activations, the activated nodes are flagged in active if it is given
+	long long _RunBlock(unsigned long long runKey, int block, int num_iter, int size, const int set[], uint8_t* active)
+	{
+		MIRandom random(MIRandom::StreamSeed(runKey, block));
+		int last = std::min(num_iter, (block + 1) * RUN_BLOCK_SIZE);
+		if (isBatchRun) {
+			// the iterations of the block are the worlds of one batch
+			BatchTraversalScratch& batch = _ThreadBatchScratch();
+			long long result = _RunBatch(random, last - block * RUN_BLOCK_SIZE, size, set, batch);
+			if (active != NULL) {
+				for (int v : batch.touched) active[v] = 1;
 			}
+			return result;
 		}
-#endif
 
-		return (double)resultSize / (double)num_iter;
+		TraversalScratch& scratch = _ThreadScratch();
+		long long result = 0;
+		for (int it = block * RUN_BLOCK_SIZE; it < last; it++)
+		{
+			scratch.Reset(this->n);
+			std::vector<int>& list = scratch.queue;
+			for (int i = 0; i < size; i++)
+			{
+				list.push_back(set[i]);
+				scratch.Visit(set[i]);
+			}
+			result += size;
+
+			size_t h = 0;
+			result += _Expand(random, scratch, h);
+
+			if (active != NULL) {
+				for (int v : list) active[v] = 1;
+			}
+		}
+		return result;
 	}
 
+	/// Simulate count (<= BATCH_SIZE) worlds at once with _ExpandBatch. On return, scratch.reached[v]
+	/// holds the worlds of v for the nodes in scratch.touched. Returns the number of activations over all the worlds
+	long long _RunBatch(MIRandom& random, int count, int size, const int set[], BatchTraversalScratch& scratch)
+	{
+		uint64_t worlds = _Worlds(count);
+		scratch.Reset(this->n);
+		for (int i = 0; i < size; i++) {
+			scratch.Reach(set[i], worlds);
+		}
+		long long result = (long long)size * count;
 
-	double _Run(int num_iter, int size, int set[], std::vector<bool>& active)
+		size_t h = 0;
+		result += _ExpandBatch(random, scratch, h);
+		return result;
+	}
+
+	/// Add the activations of every prefix set[0 ... t] in the iterations of one block to counts[t].
+	/// The seeds are added one at a time, and each one only expands the nodes it newly activates:
+	/// the coins of an edge are flipped once, when its source is activated, so the prefixes of a
+	/// world share its live edges and the whole block is one traversal per world (or per batch)
+	void _RunPrefixBlock(unsigned long long runKey, int block, int num_iter, int size, const int set[], long long* counts)
+	{
+		MIRandom random(MIRandom::StreamSeed(runKey, block));
+		int last = std::min(num_iter, (block + 1) * RUN_BLOCK_SIZE);
+		if (isBatchRun) {
+			BatchTraversalScratch& batch = _ThreadBatchScratch();
+			uint64_t worlds = _Worlds(last - block * RUN_BLOCK_SIZE);
+			batch.Reset(this->n);
+			long long result = 0;
+			size_t h = 0;
+			for (int t = 0; t < size; t++) {
+				uint64_t fresh = worlds & ~batch.reached[set[t]];
+				if (fresh != 0) {
+					batch.Reach(set[t], fresh);
+					result += BitCount(fresh);
+				}
+				result += _ExpandBatch(random, batch, h);
+				counts[t] += result;
+			}
+			return;
+		}
+
+		TraversalScratch& scratch = _ThreadScratch();
+		for (int it = block * RUN_BLOCK_SIZE; it < last; it++)
+		{
+			scratch.Reset(this->n);
+			long long result = 0;
+			size_t h = 0;
+			for (int t = 0; t < size; t++) {
+				if (!scratch.IsVisited(set[t])) {
+					scratch.queue.push_back(set[t]);
+					scratch.Visit(set[t]);
+					result++;
+				}
+				result += _Expand(random, scratch, h);
+				counts[t] += result;
+			}
+		}
+	}
+
+	/// Average number of activated nodes over num_iter iterations from the seeds set[0 ... size).
+	/// The iterations are split into blocks of RUN_BLOCK_SIZE, each drawn from its own stream, and
+	/// the blocks are spread over the threads if IsConcurrent(). So the result only depends on the run seed.
+	double _Run(int num_iter, int size, int set[]) 
 	{
 		// MI_STATIC_ASSERT(has_mem_GetNeighborCount<TGraph>::value, "TGraph should has member GetNeighborCount");
 		// MI_STATIC_ASSERT(has_mem_GetEdge<TGraph>::value, "TGraph should has member GetEdge");
@@ -175,93 +348,48 @@ protected:
 			throw NullPointerException("Please Build Graph first. (gf==NULL)");
 		}
 
-		int targetSize = size;
-		int resultSize = 0;
-		active.resize(this->n, false);
-		ProbTransfom trans(this->gf->edgeForm);
+		unsigned long long runKey = _NextRunKey();
+		int nBlocks = (num_iter + RUN_BLOCK_SIZE - 1) / RUN_BLOCK_SIZE;
+		long long resultSize = 0;
 
-#ifdef MI_USE_OMP
-		if (!IsConcurrent()) {
-#endif
-			// single thread
-			std::vector<int> list(this->n);
-			for (int it = 0; it < num_iter; it++)
-			{
-				for (int i = 0; i < targetSize; i++)
-				{
-					list[i] = set[i];
-					active[list[i]] = true;
-				}
-				resultSize += targetSize;
+#pragma omp parallel for schedule(dynamic) reduction(+:resultSize) if(IsConcurrent() && nBlocks > 1)
+		for (int b = 0; b < nBlocks; b++) {
+			resultSize += _RunBlock(runKey, b, num_iter, size, set, NULL);
+		}
 
-				int h = 0;
-				int t = targetSize;
+		return (double)resultSize / (double)num_iter;
+	}
 
-				while (h < t)
-				{
-					int k = this->gf->GetNeighborCount(list[h]);
-					//printf("%d \n",k);
-					for (int i = 0; i < k; i++)
-					{
-						auto& e = this->gf->GetEdge(list[h], i);
-						if (active[e.v]) continue;
-
-						if ((this->random).RandBernoulli(trans.Prob(e.w1)))
-						{
-							list[t] = e.v;
-							active[e.v] = true;
-							t++;
-							resultSize++;
-							//break;
-						}
-					}
-					h++;
-				}
-			}
 
+	/// As _Run above, and every node activated in any of the iterations is set in active
+	double _Run(int num_iter, int size, int set[], std::vector<bool>& active)
+	{
+		// MI_STATIC_ASSERT(has_mem_GetNeighborCount<TGraph>::value, "TGraph should has member GetNeighborCount");
+		// MI_STATIC_ASSERT(has_mem_GetEdge<TGraph>::value, "TGraph should has member GetEdge");
+		// MI_STATIC_ASSERT(has_mem_edgeForm<TGraph>::value, "TGraph should has member edgeForm");
 
-#ifdef MI_USE_OMP
+		if (this->gf == NULL) {
+			throw NullPointerException("Please Build Graph first. (gf==NULL)");
 		}
-		else {
-			// concurrent
 
-#pragma omp parallel for
-			for (int it = 0; it < num_iter; it++) {
-				std::vector<int> list(this->n);
-				for (int i = 0; i < targetSize; i++)
-				{
-					list[i] = set[i];
-					active[list[i]] = true;
-				}
-				int curResult = targetSize;
-				int h = 0;
-				int t = targetSize;
-
-				while (h < t)
-				{
-					int k = this->gf->GetNeighborCount(list[h]);
-					//printf("%d \n",k);
-					for (int i = 0; i < k; i++)
-					{
-						auto& e = this->gf->GetEdge(list[h], i);
-						if (active[e.v]) continue;
-
-						if ((this->random).RandBernoulli(trans.Prob(e.w1)))
-						{
-							list[t] = e.v;
-							active[e.v] = true;
-							t++;
-							curResult++;
-						}
-					}
-					h++;
-				}
+		unsigned long long runKey = _NextRunKey();
+		int nBlocks = (num_iter + RUN_BLOCK_SIZE - 1) / RUN_BLOCK_SIZE;
+		long long resultSize = 0;
+		active.resize(this->n, false);
 
-#pragma omp atomic
-				resultSize += curResult;
+		// every thread flags its activations in an array of its own, merged into active at the end
+#pragma omp parallel reduction(+:resultSize) if(IsConcurrent() && nBlocks > 1)
+		{
+			std::vector<uint8_t> flags(this->n, 0);
+#pragma omp for schedule(dynamic)
+			for (int b = 0; b < nBlocks; b++) {
+				resultSize += _RunBlock(runKey, b, num_iter, size, set, flags.data());
+			}
+#pragma omp critical(general_cascade_active)
+			for (int v = 0; v < this->n; v++) {
+				if (flags[v]) active[v] = true;
 			}
 		}
-#endif
 
 		return (double)resultSize / (double)num_iter;
 	}
@@ -8,6 +8,8 @@
 #include <cstring>
 #include <set>
 #include "event_timer.h"
+#include "world_cache.h"
+#include "mi_lazy_heap.h"
 
 using namespace std;
 
@@ -163,7 +165,7 @@ void Greedy::Build(IGraph& gf, int k, ICascade& cascade, int dp, int dn, int a,
 	vector<double> outEstSpread;
 
 	vector<int*> setWithTime = vector<int*>(t);
-	vector<int> seedNumber = vector<int>(top, 0);
+	vector<int> seedNumber = vector<int>(t, 0);
 	for (int i = 0; i < t; i++) {
 		int* seedSet = new int[top];
 		setWithTime[i] = seedSet;
@@ -187,7 +189,7 @@ void Greedy::Build(IGraph& gf, int k, ICascade& cascade, int dp, int dn, int a,
 	}
 
 	set<int> candidates(sourceSet);
-	vector<std::set<int>> candidatesWithTime(top, candidates);
+	vector<std::set<int>> candidatesWithTime(t, candidates);
 
 	double spread = 0;
 	for (int iter = 0; iter < top; ++iter) {
@@ -201,13 +203,13 @@ void Greedy::Build(IGraph& gf, int k, ICascade& cascade, int dp, int dn, int a,
 		}
 
 		vector<dCountComparator> camp;
-		for (int i = 0; i < top; i++) {
+		for (int i = 0; i < t; i++) {
 			dCountComparator comp(imp[i]);
 			camp.push_back(comp);
 		}
 
 		vector<pair<pair<double, int>, int>> winner; //¼ÿʱĽڵ
-		for (int i = 0; i < top; i++) {
+		for (int i = 0; i < t; i++) {
 			set<int>::const_iterator maxPtIn = max_element(candidatesWithTime[i].begin(), candidatesWithTime[i].end(), camp[i]);
 			pair<pair<double, int>, int> maxSource;
 			maxSource.first.second = *maxPtIn;
@@ -217,7 +219,7 @@ void Greedy::Build(IGraph& gf, int k, ICascade& cascade, int dp, int dn, int a,
 		}
 		PairdCountComparator comp_end(winner);
 		set<int> Timecandidates;
-		for (int i = 0; i < top; i++)
+		for (int i = 0; i < t; i++)
 		{
 			Timecandidates.insert(i);
 		}
@@ -267,7 +269,34 @@ void Greedy::Build(IGraph& gf, int k, ICascade& cascade, int dp, int dn, int a,
 	fclose(timetmpfile);
 }
 
-void Greedy::_Build(IGraph& gf, int k, GeneralCascade& cascade, int dp, int dn, int a, int t) {
+namespace {
+	/// working space of the calling thread, the candidates are spread over the omp threads
+	BatchTraversalScratch& ThreadScratch()
+	{
+		static thread_local BatchTraversalScratch scratch;
+		return scratch;
+	}
+}
+
+/// Activations of the seed j in the worlds of cache, outside of the activations outside[g] of group g.
+/// isConcurrent spreads the groups over the omp threads
+static long long ActivationsOutside(const WorldCache& cache, int j, const vector<vector<uint64_t>>& outside, bool isConcurrent)
+{
+	long long result = 0;
+	int nGroups = cache.GroupCount();
+#pragma omp parallel for schedule(static) reduction(+:result) if(isConcurrent && nGroups > 1)
+	for (int g = 0; g < nGroups; g++) {
+		BatchTraversalScratch& scratch = ThreadScratch();
+		cache.Activate(g, 1, &j, scratch);
+		const vector<uint64_t>& known = outside[g];
+		for (int v : scratch.touched) {
+			result += BitCount(scratch.reached[v] & ~known[v]);
+		}
+	}
+	return result;
+}
+
+void Greedy::_Build(Graph& gf, int k, int dp, int dn, int a, int t, int worldCount) {
 	n = gf.GetN();
 	top = k;
 	d.resize(k, 0);
@@ -277,144 +306,81 @@ void Greedy::_Build(IGraph& gf, int k, GeneralCascade& cascade, int dp, int dn,
 	std::vector<std::pair<int, int>> listWithTime;
 	listWithTime.resize(k, listWT);
 
-	vector< pair< int, int > > outSeeds;
-	vector<double> outEstSpread;
-
-	vector<int*> setWithTime = vector<int*>(t);
-	vector<int> seedNumber = vector<int>(top, 0);
-	for (int i = 0; i < t; i++) {
-		int* seedSet = new int[top];
-		setWithTime[i] = seedSet;
-	}
-
-	vector<double> oldWithTime = vector<double>(t);
-	for (int i = 0; i < t; i++) {
-		double old = 0.0;
-		oldWithTime[i] = old;
-	}
-
-	vector<vector<double>> imp = vector<vector<double>>(t, vector<double>(n));
-
 	/*㷨ʼ*/
 	EventTimer pctimer;
 	pctimer.SetTimeEvent("start");
 
-	std::set<int> sourceSet;
-	for (int i = 0; i < n; i++) {
-		sourceSet.insert(i);
+	// the cascades of every time slice run in worldCount worlds of its own, sampled once.
+	// in a world, the seeds of a slice activate the union of what each of them activates,
+	// so the gain of seed j in slice i is what j reaches outside of the activations of the
+	// slices 0 ... i, and it can only drop as seeds are added: the greedy is lazy forward
+	vector<WorldCache> worlds(t);
+	for (int i = 0; i < t; i++) {
+		worlds[i].streamKey = i;
+		worlds[i].Build(gf, worldCount);
 	}
-
-	set<int> candidates(sourceSet);
-	vector<std::set<int>> candidatesWithTime(top, candidates);
-
-	double spread = 0;
-	for (int iter = 0; iter < top; ++iter) {
-
-		for (int i = 0; i < t; i++) {
-			for (int j = 0; j < n; j++) {
-				//ģ500
-				int round = 500;
-				vector<int> all_count = vector<int>(round, 0);
-#pragma omp parallel for
-				for (int r = 0; r < round; r++) {
-					// ûдǰӰ쵽Ľڵ㼯
-					std::vector<bool> old_active = vector<bool>(n, false);
-					for (int k = 0; k <= i; k++) {
-						std::vector<bool> active;
-						cascade.Run(1, seedNumber[k], setWithTime[k], active);
-						for (int single_node = 0; single_node < active.size(); single_node++) {
-							if (active[single_node]) {
-								old_active[single_node] = true;
-							}
-						}
-					}
-					// ϴӺӰ쵽Ľڵ㼯
-					setWithTime[i][seedNumber[i]] = j;
-					std::vector<bool> new_active = vector<bool>(n, false);
-					int active_number = 0;
-					for (int k = 0; k <= i; k++) {
-						std::vector<bool> active;
-						cascade.Run(1, seedNumber[k] + 1, setWithTime[k], active);
-						for (int single_node = 0; single_node < active.size(); single_node++) {
-							if (active[single_node]) {
-								new_active[single_node] = true;
-							}
-						}
-					}
-					// Ľڵ
-					for (int single_node = 0; single_node < new_active.size(); single_node++) {
-						if (new_active[single_node] && !old_active[single_node]) {
-							all_count[r]++;
-						}
-					}
-				}
-				//ƽֵ
-				double inf = 0;
-				for (int r = 0; r < round; r++) {
-					inf += all_count[r];
-				}
-				inf /= (double)round;
-				imp[i][j] = Weight_iter(dn, dp, a, i + 1) * inf;
-			}
-		}
-
-		vector<dCountComparator> camp;
-		for (int i = 0; i < top; i++) {
-			dCountComparator comp(imp[i]);
-			camp.push_back(comp);
-		}
-
-		vector<pair<pair<double, int>, int>> winner; //¼ÿʱĽڵ
-		for (int i = 0; i < top; i++) {
-			set<int>::const_iterator maxPtIn = max_element(candidatesWithTime[i].begin(), candidatesWithTime[i].end(), camp[i]);
-			pair<pair<double, int>, int> maxSource;
-			maxSource.first.second = *maxPtIn;
-			maxSource.first.first = imp[i][*maxPtIn];
-			maxSource.second = i;
-			winner.push_back(maxSource);
-		}
-		PairdCountComparator comp_end(winner);
-		set<int> Timecandidates;
-		for (int i = 0; i < top; i++)
-		{
-			Timecandidates.insert(i);
+	int nGroups = (t > 0) ? worlds[0].GroupCount() : 0;
+	// activeWithTime[i][g][v]: worlds of group g in which v is activated by the seeds of the slices 0 ... i
+	vector<vector<vector<uint64_t>>> activeWithTime(t, vector<vector<uint64_t>>(nGroups, vector<uint64_t>(n, 0)));
+
+	// candidate (slice i, node j) has the id (t - 1 - i) * n + j. its gain is up to date
+	// if it was evaluated with the seeds chosen so far in the slices 0 ... i.
+	// the heap takes the smallest id on ties: the latest slice, then the smallest node, as before
+	int nCandidates = t * n;
+	vector<double> imp(nCandidates);
+	vector<int> lastupdate(nCandidates, 0);
+	vector<int> seedsUpTo(t, 0);
+	vector<bool> isCandidate(nCandidates, true);
+	vector<int> ids(nCandidates);
+	// the first gains are the bulk of the work: every thread takes whole candidates
+#pragma omp parallel for schedule(dynamic, 64) if(IsConcurrent())
+	for (int id = 0; id < nCandidates; id++) {
+		int i = t - 1 - id / n;
+		ids[id] = id;
+		imp[id] = Weight_iter(dn, dp, a, i + 1) * ActivationsOutside(worlds[i], id % n, activeWithTime[i], false) / worldCount;
+	}
+	LazyMaxHeap heap;
+	heap.Build(ids.begin(), ids.end(), imp);
+
+	int nSeeds = 0;
+	for (; nSeeds < top; ++nSeeds) {
+		int best;
+		while (true) {
+			best = heap.Top(imp, isCandidate);
+			if (best < 0) break;
+			int i = t - 1 - best / n;
+			if (lastupdate[best] == seedsUpTo[i]) break;
+			imp[best] = Weight_iter(dn, dp, a, i + 1) * ActivationsOutside(worlds[i], best % n, activeWithTime[i], IsConcurrent()) / worldCount;
+			lastupdate[best] = seedsUpTo[i];
 		}
-		set<int>::const_iterator maxPt = max_element(Timecandidates.begin(), Timecandidates.end(), comp_end);
-		pair<int, int> maxSourceWithTime;
-		maxSourceWithTime.first = winner[*maxPt].first.second; // node id
-		maxSourceWithTime.second = winner[*maxPt].second; // time
-		// cout << "" << maxSource << "\t";
-		assert(imp[winner[*maxPt].second][maxSourceWithTime.first] >= 0);
+		// no candidate left (k > t * n)
+		if (best < 0) break;
+		int node = best % n;
+		int time = t - 1 - best / n;
 
 		// selected one node
-		listWithTime[iter].first = maxSourceWithTime.first;
-		listWithTime[iter].second = maxSourceWithTime.second + 1;
-
-		// ¼߼Ч
-		setWithTime[maxSourceWithTime.second][seedNumber[maxSourceWithTime.second]] = maxSourceWithTime.first;
-		seedNumber[maxSourceWithTime.second] += 1;
-
-		// estimate spread
-		spread = spread + imp[maxSourceWithTime.second][maxSourceWithTime.first];
-
-		// if (iter==0)
-		// {
-		// 	  cout << "hhh" << maxSource << (double)n * degrees[28] / table.size() << "hhh" << endl;
-		// }
-
-		d[iter] = imp[maxSourceWithTime.second][maxSourceWithTime.first];
-		oldWithTime[maxSourceWithTime.second] += imp[maxSourceWithTime.second][maxSourceWithTime.first];
-
-		// ɾֵĽڵ
-		/*
-		for (int i = 0; i < t; i++) {
-			candidatesWithTime[i].erase(maxSourceWithTime.first);
+		listWithTime[nSeeds].first = node;
+		listWithTime[nSeeds].second = time + 1;
+		d[nSeeds] = imp[best];
+		// ֻɾһֵĽڵ
+		isCandidate[best] = false;
+
+		// the new activations join the baselines of this slice and of the later ones
+#pragma omp parallel for schedule(static) if(IsConcurrent() && nGroups > 1)
+		for (int g = 0; g < nGroups; g++) {
+			BatchTraversalScratch& scratch = ThreadScratch();
+			worlds[time].Activate(g, 1, &node, scratch);
+			for (int i = time; i < t; i++) {
+				vector<uint64_t>& active = activeWithTime[i][g];
+				for (int v : scratch.touched) active[v] |= scratch.reached[v];
+			}
+		}
+		for (int i = time; i < t; i++) {
+			seedsUpTo[i]++;
 		}
-		*/
-		candidatesWithTime[maxSourceWithTime.second].erase(maxSourceWithTime.first);   //ֻɾһֵĽڵ
-		//degreesWithTime[maxSourceWithTime.second][maxSourceWithTime.first] = -1;   ƺǶһ
-
 	}
+	listWithTime.resize(nSeeds);
+	d.resize(nSeeds);
 	pctimer.SetTimeEvent("end");
 	/**/
 	file = "rr_imm_infl.txt";
@@ -47,7 +47,8 @@ public:
 
 	void Build(IGraph& gf, int k, ICascade& cascade);
 	void Build(IGraph& gf, int k, ICascade& cascade, int dp, int dn, int a, int t);
-	void _Build(IGraph& gf, int k, GeneralCascade& cascade, int dp, int dn, int a, int t);
+	/// Time-aware greedy with lazy forward, the cascades of every slice evaluated on worldCount worlds sampled once
+	void _Build(Graph& gf, int k, int dp, int dn, int a, int t, int worldCount);
 	void BuildRanking(IGraph& gf, int k, ICascade& cascade);
 	void BuildFromFile(IGraph& gf, const char* filename);
 	void WriteToFileWithTime(const std::string& filename, IGraph& gf, std::vector<std::pair<int, int>> listWithTime);
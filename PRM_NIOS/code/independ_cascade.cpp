@@ -20,6 +20,7 @@ double IndependCascade::Run(int num_iter, int size, int set[])
 
 	int targetSize = size;
 	int resultSize = 0;
+	uint32_t threshold = MIRandom::ProbThreshold(ratio);
 
 	int	h, t;
 	int* list = new int[n];
@@ -48,7 +49,7 @@ double IndependCascade::Run(int num_iter, int size, int set[])
 				if (active[e.v]) continue;
 				//printf("%d %d %g %g\n", e.u, e.v, exp(-e.w1), exp(-e.w2));
 				//for (int j=0; j< e.c; j++)
-				if (random.RandBernoulli(ratio))
+				if (random.RandAccept(threshold))
 				{
 					list[t] = e.v;
 					active[e.v] = true;
@@ -0,0 +1,233 @@
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include "mi_argmax.h"
+
+// GCC and Clang build the AVX paths for their target only and pick one at run time,
+// other compilers use the ones the build targets (e.g. MSVC /arch:AVX2)
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MI_ARGMAX_DISPATCH
+#define MI_TARGET(isa) __attribute__((target(isa)))
+#define MI_ARGMAX_AVX2
+#define MI_ARGMAX_AVX512
+#else
+#define MI_TARGET(isa)
+#if defined(__AVX2__)
+#define MI_ARGMAX_AVX2
+#endif
+#if defined(__AVX512F__)
+#define MI_ARGMAX_AVX512
+#endif
+#endif
+
+#if defined(MI_ARGMAX_AVX2) || defined(MI_ARGMAX_AVX512)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+namespace {
+	enum SimdLevel { SIMD_NONE, SIMD_AVX2, SIMD_AVX512 };
+
+	SimdLevel DetectSimd()
+	{
+#if defined(MI_ARGMAX_DISPATCH)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) return SIMD_AVX512;
+		if (__builtin_cpu_supports("avx2")) return SIMD_AVX2;
+		return SIMD_NONE;
+#elif defined(MI_ARGMAX_AVX512)
+		return SIMD_AVX512;
+#elif defined(MI_ARGMAX_AVX2)
+		return SIMD_AVX2;
+#else
+		return SIMD_NONE;
+#endif
+	}
+
+	const SimdLevel simdLevel = DetectSimd();
+
+	/// Take counts[i] if it beats the best so far: a larger count, or an equal one if isLastOnTies
+	/// (the positions come in ascending order)
+	template <class T>
+	inline void Visit(T count, int i, bool isLastOnTies, T& best, int& bestPos)
+	{
+		if (bestPos < 0 || best < count || (isLastOnTies && best == count)) {
+			best = count;
+			bestPos = i;
+		}
+	}
+
+	/// Merge the best of every lane, a lane holds the positions i with the same i % lanes
+	template <class T, class I>
+	void ReduceLanes(const T* values, const I* positions, int lanes, bool isLastOnTies, T& best, int& bestPos)
+	{
+		for (int l = 0; l < lanes; ++l) {
+			int pos = (int)positions[l];
+			if (pos < 0) continue;
+			if (bestPos < 0 || best < values[l]
+				|| (best == values[l] && (isLastOnTies ? pos > bestPos : pos < bestPos))) {
+				best = values[l];
+				bestPos = pos;
+			}
+		}
+	}
+
+	// the kernels below scan a prefix of the counts, keeping the best value and its position per lane,
+	// and return the length of the prefix. a lane takes the count if its mask is set and the count is
+	// larger (or not smaller if isLastOnTies), or if the lane holds no position yet
+
+#if defined(MI_ARGMAX_AVX2)
+	template <bool isLastOnTies>
+	MI_TARGET("avx2")
+	int ArgMaxAvx2(const double* counts, const uint8_t* mask, int n, double& best, int& bestPos)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i step = _mm256_set1_epi64x(4);
+		__m256d vmax = _mm256_set1_pd(-numeric_limits<double>::infinity());
+		__m256i vpos = _mm256_set1_epi64x(-1);
+		__m256i vi = _mm256_set_epi64x(3, 2, 1, 0);
+		int i = 0;
+		for (; i + 4 <= n; i += 4) {
+			int32_t m4;
+			memcpy(&m4, mask + i, sizeof(m4));
+			__m256d k = _mm256_castsi256_pd(_mm256_cmpgt_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(m4)), zero));
+			__m256d v = _mm256_loadu_pd(counts + i);
+			__m256d take = isLastOnTies ? _mm256_cmp_pd(v, vmax, _CMP_GE_OQ) : _mm256_cmp_pd(v, vmax, _CMP_GT_OQ);
+			take = _mm256_and_pd(k, _mm256_or_pd(take, _mm256_castsi256_pd(_mm256_cmpgt_epi64(zero, vpos))));
+			vmax = _mm256_blendv_pd(vmax, v, take);
+			vpos = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(vpos), _mm256_castsi256_pd(vi), take));
+			vi = _mm256_add_epi64(vi, step);
+		}
+		double values[4];
+		int64_t positions[4];
+		_mm256_storeu_pd(values, vmax);
+		_mm256_storeu_si256((__m256i*)positions, vpos);
+		ReduceLanes(values, positions, 4, isLastOnTies, best, bestPos);
+		return i;
+	}
+
+	template <bool isLastOnTies>
+	MI_TARGET("avx2")
+	int ArgMaxAvx2(const int* counts, const uint8_t* mask, int n, int& best, int& bestPos)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i step = _mm256_set1_epi32(8);
+		__m256i vmax = _mm256_set1_epi32(numeric_limits<int>::min());
+		__m256i vpos = _mm256_set1_epi32(-1);
+		__m256i vi = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m256i k = _mm256_cmpgt_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(mask + i))), zero);
+			__m256i v = _mm256_loadu_si256((const __m256i*)(counts + i));
+			__m256i take = isLastOnTies
+				? _mm256_andnot_si256(_mm256_cmpgt_epi32(vmax, v), _mm256_set1_epi32(-1))
+				: _mm256_cmpgt_epi32(v, vmax);
+			take = _mm256_and_si256(k, _mm256_or_si256(take, _mm256_cmpgt_epi32(zero, vpos)));
+			vmax = _mm256_blendv_epi8(vmax, v, take);
+			vpos = _mm256_blendv_epi8(vpos, vi, take);
+			vi = _mm256_add_epi32(vi, step);
+		}
+		int values[8];
+		int positions[8];
+		_mm256_storeu_si256((__m256i*)values, vmax);
+		_mm256_storeu_si256((__m256i*)positions, vpos);
+		ReduceLanes(values, positions, 8, isLastOnTies, best, bestPos);
+		return i;
+	}
+#endif
+
+#if defined(MI_ARGMAX_AVX512)
+	template <bool isLastOnTies>
+	MI_TARGET("avx512f")
+	int ArgMaxAvx512(const double* counts, const uint8_t* mask, int n, double& best, int& bestPos)
+	{
+		const __m512i zero = _mm512_setzero_si512();
+		const __m512i step = _mm512_set1_epi64(8);
+		__m512d vmax = _mm512_set1_pd(-numeric_limits<double>::infinity());
+		__m512i vpos = _mm512_set1_epi64(-1);
+		__m512i vi = _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0);
+		int i = 0;
+		for (; i + 8 <= n; i += 8) {
+			__m512i m = _mm512_maskz_cvtepu8_epi64(0xFF, _mm_loadl_epi64((const __m128i*)(mask + i)));
+			__mmask8 k = _mm512_test_epi64_mask(m, m);
+			__m512d v = _mm512_loadu_pd(counts + i);
+			__mmask8 take = isLastOnTies ? _mm512_mask_cmp_pd_mask(k, v, vmax, _CMP_GE_OQ) : _mm512_mask_cmp_pd_mask(k, v, vmax, _CMP_GT_OQ);
+			take |= _mm512_mask_cmplt_epi64_mask(k, vpos, zero);
+			vmax = _mm512_mask_mov_pd(vmax, take, v);
+			vpos = _mm512_mask_mov_epi64(vpos, take, vi);
+			vi = _mm512_add_epi64(vi, step);
+		}
+		double values[8];
+		int64_t positions[8];
+		_mm512_storeu_pd(values, vmax);
+		_mm512_storeu_si512((void*)positions, vpos);
+		ReduceLanes(values, positions, 8, isLastOnTies, best, bestPos);
+		return i;
+	}
+
+	template <bool isLastOnTies>
+	MI_TARGET("avx512f")
+	int ArgMaxAvx512(const int* counts, const uint8_t* mask, int n, int& best, int& bestPos)
+	{
+		const __m512i zero = _mm512_setzero_si512();
+		const __m512i step = _mm512_set1_epi32(16);
+		__m512i vmax = _mm512_set1_epi32(numeric_limits<int>::min());
+		__m512i vpos = _mm512_set1_epi32(-1);
+		__m512i vi = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+		int i = 0;
+		for (; i + 16 <= n; i += 16) {
+			__m512i m = _mm512_maskz_cvtepu8_epi32(0xFFFF, _mm_loadu_si128((const __m128i*)(mask + i)));
+			__mmask16 k = _mm512_test_epi32_mask(m, m);
+			__m512i v = _mm512_loadu_si512((const void*)(counts + i));
+			__mmask16 take = isLastOnTies ? _mm512_mask_cmpge_epi32_mask(k, v, vmax) : _mm512_mask_cmpgt_epi32_mask(k, v, vmax);
+			take |= _mm512_mask_cmplt_epi32_mask(k, vpos, zero);
+			vmax = _mm512_mask_mov_epi32(vmax, take, v);
+			vpos = _mm512_mask_mov_epi32(vpos, take, vi);
+			vi = _mm512_add_epi32(vi, step);
+		}
+		int values[16];
+		int positions[16];
+		_mm512_storeu_si512((void*)values, vmax);
+		_mm512_storeu_si512((void*)positions, vpos);
+		ReduceLanes(values, positions, 16, isLastOnTies, best, bestPos);
+		return i;
+	}
+#endif
+
+	template <class T>
+	int ArgMax(const T* counts, const uint8_t* mask, int n, bool isLastOnTies)
+	{
+		T best = T();
+		int bestPos = -1;
+		int i = 0;
+#if defined(MI_ARGMAX_AVX512)
+		if (simdLevel == SIMD_AVX512) {
+			i = isLastOnTies ? ArgMaxAvx512<true>(counts, mask, n, best, bestPos)
+				: ArgMaxAvx512<false>(counts, mask, n, best, bestPos);
+		}
+#endif
+#if defined(MI_ARGMAX_AVX2)
+		if (simdLevel == SIMD_AVX2) {
+			i = isLastOnTies ? ArgMaxAvx2<true>(counts, mask, n, best, bestPos)
+				: ArgMaxAvx2<false>(counts, mask, n, best, bestPos);
+		}
+#endif
+		for (; i < n; ++i) {
+			if (mask[i]) Visit(counts[i], i, isLastOnTies, best, bestPos);
+		}
+		return bestPos;
+	}
+}
+
+
+int MaskedArgMax(const double* counts, const uint8_t* mask, int n, bool isLastOnTies)
+{
+	return ArgMax(counts, mask, n, isLastOnTies);
+}
+
+int MaskedArgMax(const int* counts, const uint8_t* mask, int n, bool isLastOnTies)
+{
+	return ArgMax(counts, mask, n, isLastOnTies);
+}
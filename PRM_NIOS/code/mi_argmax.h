@@ -0,0 +1,17 @@
+#ifndef mi_argmax_h__
+#define mi_argmax_h__
+
+#include <cstdint>
+
+
+/// Position of the largest counts[i] among i < n with mask[i] != 0, or -1 if no mask is set.
+/// Ties go to the smallest position, or to the largest one if isLastOnTies
+/// (as std::max_element over ascending ids with a < or a <= comparator).
+///
+/// One pass keeps the best count and its position per lane, with AVX-512 or AVX2 when the CPU has them
+/// (checked at run time with GCC/Clang, taken from the build target otherwise), and a scalar loop otherwise.
+int MaskedArgMax(const double* counts, const uint8_t* mask, int n, bool isLastOnTies);
+int MaskedArgMax(const int* counts, const uint8_t* mask, int n, bool isLastOnTies);
+
+
+#endif // mi_argmax_h__
@@ -0,0 +1,82 @@
+#ifndef mi_bucket_queue_h__
+#define mi_bucket_queue_h__
+
+#include <vector>
+#include <algorithm>
+
+
+/// Bucket queue for the max-cover greedy: picks the node of largest count, where counts only decrease.
+/// The counts stay in the caller's array. A node whose count dropped is moved to its new bucket
+/// lazily, when it comes up in the bucket it sits in. So a decrement costs nothing here and may happen
+/// concurrently, and every move is paid by a decrement that was made before.
+/// Every bucket is a binary heap on the node ids, so the node winning a tie is always at its front.
+class BucketQueue
+{
+protected:
+	/// buckets[c]: nodes last seen with count c, a heap ordered by idLess
+	std::vector< std::vector<int> > buckets;
+	/// no node sits above this bucket
+	int top;
+	/// which node wins a tie: the smallest id, or the largest one
+	bool isLargestIdFirst;
+
+	/// heap order of the buckets: the front is the smallest id, or the largest one
+	struct IdLess
+	{
+		bool isLargestIdFirst;
+		explicit IdLess(bool isLargestIdFirst) : isLargestIdFirst(isLargestIdFirst) {}
+		bool operator () (int a, int b) const { return isLargestIdFirst ? a < b : a > b; }
+	};
+
+	void _Push(int c, int v)
+	{
+		std::vector<int>& bucket = buckets[c];
+		bucket.push_back(v);
+		std::push_heap(bucket.begin(), bucket.end(), IdLess(isLargestIdFirst));
+	}
+
+public:
+	explicit BucketQueue(bool isLargestIdFirst = false) : top(-1), isLargestIdFirst(isLargestIdFirst) {}
+
+	/// Queue the nodes first ... last with their counts (negative counts are left out)
+	template <class TIter>
+	void Build(TIter first, TIter last, const std::vector<int>& counts)
+	{
+		buckets.clear();
+		top = -1;
+		for (TIter it = first; it != last; ++it) {
+			int c = counts[*it];
+			if (c < 0) continue;
+			if (c >= (int)buckets.size()) buckets.resize(c + 1);
+			buckets[c].push_back(*it);
+			top = std::max(top, c);
+		}
+		for (std::vector<int>& bucket : buckets) {
+			std::make_heap(bucket.begin(), bucket.end(), IdLess(isLargestIdFirst));
+		}
+	}
+
+	/// Remove and return the node of the largest count, or -1 if no node is left.
+	/// Ties are broken by id (see isLargestIdFirst). Nodes with negative counts are dropped.
+	int PopMax(const std::vector<int>& counts)
+	{
+		IdLess less(isLargestIdFirst);
+		while (top >= 0) {
+			std::vector<int>& bucket = buckets[top];
+			while (!bucket.empty()) {
+				int v = bucket.front();
+				std::pop_heap(bucket.begin(), bucket.end(), less);
+				bucket.pop_back();
+				int c = counts[v];
+				if (c == top) return v;
+				// count dropped since v was filed: move it down
+				if (c >= 0) _Push(c, v);
+			}
+			--top;
+		}
+		return -1;
+	}
+};
+
+
+#endif // mi_bucket_queue_h__
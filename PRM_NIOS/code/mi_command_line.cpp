@@ -12,6 +12,12 @@ std::string MICommandLine::Help()
 		MI_SOFTWARE_META "\n"
 		"\n"
 		"-h: print the help \n"
+		"--seed <s>: fix the random seed of the run, can be appended to any switch \n"
+		"--batch: sample RR sets, and simulate the worlds of -t/-tp, in bit-parallel batches of 64, can be appended to any switch \n"
+		"--compress: store RR sets delta/varint or bitmap packed to save memory, can be appended to any switch \n"
+		"--rr-cache <dir>: keep the RR samples of -rr5/-rr6 in <dir> and reuse them in later runs with the same graph, time and --seed \n"
+		"--worlds <R>: -g and -r evaluate seed sets on R live-edge worlds sampled once, instead of fresh simulations: N simulations use the first min(N, R) worlds (-g mode 1: all R worlds of every time slice, 500 by default) \n"
+		"--adaptive <epsilon> <confidence>: -t stops once the <confidence> interval of every spread is within +-<epsilon> times the spread, num_iter (rounded up to whole blocks of 64) is the cap. <epsilon> > 0, 0 < <confidence> < 1 \n"
 		"-g : greedy algorithm for PRM NIOS and OINS setting\n"
 		"-tp simulate the process of PA-IC in NIOS setting and evaluate the result of different algorithm. \n"
 		"-t seeds_file <num_iter=10000> <seed_set_size = 50> <output_file=GC_spread.txt> <nthreads=1> <mode=0>: test influence spread with seeds \n"
@@ -48,10 +54,47 @@ int MICommandLine::Main(int argc, char * argv[])
 	return Main(argc, argVec);
 }
 
+int MICommandLine::StripOptions(int argc, std::vector<std::string>& argv)
+{
+	std::vector<std::string> rest;
+	for (int i = 0; i < argc; i++) {
+		const std::string& option = argv[i];
+		// number of values that follow the option
+		int count = -1;
+		if (option == "--batch" || option == "--compress") count = 0;
+		else if (option == "--seed" || option == "--rr-cache" || option == "--worlds") count = 1;
+		else if (option == "--adaptive") count = 2;
+		if (i == 0 || count < 0 || i + count >= argc) {
+			rest.push_back(option);
+			continue;
+		}
+
+		if (option == "--batch") isBatchSampling = true;
+		else if (option == "--compress") isCompressedRR = true;
+		else if (option == "--seed") MIRandom::SetRunSeed(std::stoull(argv[i + 1]));
+		else if (option == "--rr-cache") rrCacheDir = argv[i + 1];
+		else if (option == "--worlds") worldCount = std::stoi(argv[i + 1]);
+		else if (option == "--adaptive") {
+			isAdaptive = true;
+			adaptiveEpsilon = std::stod(argv[i + 1]);
+			adaptiveConfidence = std::stod(argv[i + 2]);
+		}
+		i += count;
+	}
+	argv.swap(rest);
+	return (int)argv.size();
+}
+
 int MICommandLine::Main(int argc, std::vector<std::string>& argv)
 {
 	srand((unsigned)time(NULL));
-	
+
+	argc = StripOptions(argc, argv);
+	if (isAdaptive && !(adaptiveEpsilon > 0 && adaptiveConfidence > 0 && adaptiveConfidence < 1)) {
+		std::cout << "--adaptive: <epsilon> must be > 0 and <confidence> within (0, 1)" << std::endl;
+		return 1;
+	}
+
 	if (argc <= 1) {
 		std::cout << Help() << std::endl;
 		return 0;
@@ -67,6 +110,9 @@ int MICommandLine::Main(int argc, std::vector<std::string>& argv)
 		return 0;
 	}
 
+	// fix the run seed before any sampling starts, and print it so that the run can be repeated
+	std::cout << "seed = " << MIRandom::GetRunSeed() << std::endl;
+
 	// the following contains switches for algorithms
 	system("mkdir tmp");
 	system("cd tmp");
@@ -147,6 +193,7 @@ void MICommandLine::TestSeeds(int argc, std::vector<std::string>& argv)
 	}
 
 	cascade.nthreads = (nthreads <= 1) ? 1 : nthreads;
+	cascade.isBatchRun = isBatchSampling;
 
 	SeedIO io;
 	std::vector<int> seeds = io.Read(seeds_file, gf);
@@ -155,8 +202,14 @@ void MICommandLine::TestSeeds(int argc, std::vector<std::string>& argv)
 	EventTimer timer;
 	timer.SetTimeEvent("start");
 
-	if (mode == 0) {
-		Simu(seeds, outfile, size, num_iter).toSimulate(cascade);
+	if (isAdaptive) {
+		Simu simu(seeds, outfile, size, num_iter);
+		simu.epsilon = adaptiveEpsilon;
+		simu.confidence = adaptiveConfidence;
+		simu.toSimulateAdaptive(cascade, mode == 0);
+	}
+	else if (mode == 0) {
+		Simu(seeds, outfile, size, num_iter).toSimulatePrefixes(cascade);
 	}
 	else {
 		Simu(seeds, outfile, size, num_iter).toSimulateOnceFile(cascade);
@@ -200,6 +253,7 @@ void MICommandLine::TestPRM2(int argc, std::vector<std::string>& argv){
 	int num_iter = 1;
 
 	cascade.nthreads = (nthreads <= 1) ? 1 : nthreads;
+	cascade.isBatchRun = isBatchSampling;
 	std::ifstream inFile(seeds_list_file, ios_base::in);
 	//inFile.open(seeds_list_file, ios_base::in);
 	string seeds_file;
@@ -212,44 +266,80 @@ void MICommandLine::TestPRM2(int argc, std::vector<std::string>& argv){
 	vector<bool> active_new;
 	EventTimer timer;
 	double all_ratio = 0;
-	for (int i = 0; i < simu_time; i++) {
-		double new_dp = dp;
-		double new_dn = dn;
-		int marginal_index = 0;
-		for (int i = 0; i < seeds_file_list.size(); i++) {
-			SeedIO io;
-			string seeds_file_name = seeds_file_list[i];
-			std::vector<int> seeds = io.Read(seeds_file_name, gf);
-			int size = int(seeds.size());
-
-			timer.SetTimeEvent("start");
-			int marginal = 0;
-			active_new = Simu(seeds, outfile, size, num_iter).toSimulatePRM2(cascade);
-			if (marginal_index == 0) {
-				for (int acti = 0; acti < active_new.size();acti++) {
-					if (active_new[acti]) {
-						marginal++;
-						//active_old[i] = true;
+	if (cascade.isBatchRun) {
+		// the processes are simulated BATCH_SIZE at a time, one world each:
+		// bit w of worlds[v] tells whether v is activated in process first + w
+		for (int first = 0; first < simu_time; first += GeneralCascade::BATCH_SIZE) {
+			int count = min(GeneralCascade::BATCH_SIZE, simu_time - first);
+			vector<double> new_dp(count, dp);
+			vector<double> new_dn(count, dn);
+			vector<uint64_t> worlds;
+			vector<uint64_t> worlds_old(gf.GetN(), 0);
+			for (size_t i = 0; i < seeds_file_list.size(); i++) {
+				SeedIO io;
+				std::vector<int> seeds = io.Read(seeds_file_list[i], gf);
+				int size = int(seeds.size());
+
+				timer.SetTimeEvent("start");
+				cascade.RunBatch(count, size, seeds.data(), worlds);
+				vector<int> marginal(count, 0);
+				for (int v = 0; v < gf.GetN(); v++) {
+					for (uint64_t bits = worlds[v] & ~worlds_old[v]; bits != 0; bits &= bits - 1) {
+						marginal[LowestBitIndex(bits)]++;
 					}
+					worlds_old[v] |= worlds[v];
 				}
-				active_old = active_new;
-				marginal_index = 1;
+				for (int w = 0; w < count; w++) {
+					double rate = new_dn[w] / (new_dp[w] + new_dn[w]);
+					new_dp[w] += (1 - rate) * a;
+					new_dn[w] += rate * a + marginal[w];
+				}
+			}
+			for (int w = 0; w < count; w++) {
+				all_ratio += new_dn[w] / new_dp[w];
 			}
-			else {
-				for (int it = 0; it < active_new.size(); it++) {
-					if (active_new[it] && !active_old[it]) {
-						marginal++;
-						active_old[it] = true;
+		}
+	}
+	else {
+		for (int i = 0; i < simu_time; i++) {
+			double new_dp = dp;
+			double new_dn = dn;
+			int marginal_index = 0;
+			for (size_t i = 0; i < seeds_file_list.size(); i++) {
+				SeedIO io;
+				string seeds_file_name = seeds_file_list[i];
+				std::vector<int> seeds = io.Read(seeds_file_name, gf);
+				int size = int(seeds.size());
+
+				timer.SetTimeEvent("start");
+				int marginal = 0;
+				active_new = Simu(seeds, outfile, size, num_iter).toSimulatePRM2(cascade);
+				if (marginal_index == 0) {
+					for (size_t acti = 0; acti < active_new.size(); acti++) {
+						if (active_new[acti]) {
+							marginal++;
+							//active_old[i] = true;
+						}
+					}
+					active_old = active_new;
+					marginal_index = 1;
+				}
+				else {
+					for (size_t it = 0; it < active_new.size(); it++) {
+						if (active_new[it] && !active_old[it]) {
+							marginal++;
+							active_old[it] = true;
+						}
 					}
+
 				}
+				double rate = new_dn / (new_dp + new_dn);
+				new_dp += (1 - rate) * a;
+				new_dn += rate * a + marginal;
 
 			}
-			double rate = new_dn / (new_dp + new_dn);
-			new_dp += (1 - rate) * a;
-			new_dn += rate * a + marginal;
-
+			all_ratio += new_dn / new_dp;
 		}
-		all_ratio += new_dn / new_dp;
 	}
 	cout << "R:" << all_ratio / simu_time << endl;
 	timer.SetTimeEvent("end");
@@ -268,8 +358,11 @@ void MICommandLine::BuildRanking(int argc, std::vector<std::string>& argv)
 	Graph gf = fact.Build(std::cin);
 	GeneralCascade cascade;
 	cascade.Build(gf);
+	WorldCache worlds;
+	if (worldCount > 0) worlds.Build(gf, worldCount);
+	ICascade& evaluator = (worldCount > 0) ? (ICascade&)worlds : (ICascade&)cascade;
 	Greedy alg;
-	alg.BuildRanking(gf, 100, cascade);
+	alg.BuildRanking(gf, 100, evaluator);
 }
 
 
@@ -297,15 +390,18 @@ void MICommandLine::GreedyAlg(int argc, std::vector<std::string>& argv)
 	Graph gf = fact.Build(std::cin);
 	GeneralCascade cascade;
 	cascade.Build(gf);
+	WorldCache worlds;
+	if (worldCount > 0) worlds.Build(gf, worldCount);
+	ICascade& evaluator = (worldCount > 0) ? (ICascade&)worlds : (ICascade&)cascade;
 
 	EventTimer timer;
 	timer.SetTimeEvent("start");
 	Greedy alg;
 	if (mode == 0) {
-		alg.Build(gf, min(topk, gf.GetN()), cascade, d_p, d_n, a, time);
+		alg.Build(gf, min(topk, gf.GetN()), evaluator, d_p, d_n, a, time);
 	}
 	else {
-		alg._Build(gf, min(topk, gf.GetN()), cascade, d_p, d_n, a, time);
+		alg._Build(gf, min(topk, gf.GetN()), d_p, d_n, a, time, (worldCount > 0) ? worldCount : 500);
 	}
 	
 	timer.SetTimeEvent("end");
@@ -472,6 +568,9 @@ void MICommandLine::RRAlg(int argc, std::vector<std::string>& argv)
 		std::cout << "#seeds = " << maxK << endl;
 		RRInfl infl;
 		infl.isConcurrent = isConcurrent;
+		infl.isBatchSampling = isBatchSampling;
+		infl.isCompressedRR = isCompressedRR;
+		infl.rrCacheDir = rrCacheDir;
 		infl.Build(gf, maxK, cascade, num_iter);
 		char rrinfl_simu_file[] = "GC_rr_infl.txt";
 		// toSimulate(rrinfl_simu_file, RRInfl::GetNode, GeneralCascade::Run);
@@ -485,6 +584,9 @@ void MICommandLine::RRAlg(int argc, std::vector<std::string>& argv)
 		std::cout << "ell = " << ell << endl;
 		TimPlus infl;
 		infl.isConcurrent = isConcurrent;
+		infl.isBatchSampling = isBatchSampling;
+		infl.isCompressedRR = isCompressedRR;
+		infl.rrCacheDir = rrCacheDir;
 		infl.Build(gf, maxK, cascade, eps, ell);
 		//char rrinfl_simu_file[] = "GC_rr_timplus_infl.txt";
 		// toSimulate(rrinfl_simu_file, TimPlus::GetNode, GeneralCascade::Run);
@@ -500,6 +602,9 @@ void MICommandLine::RRAlg(int argc, std::vector<std::string>& argv)
 		std::cout << "isConcurrent = " << isConcurrent << endl;
 		IMM infl;
 		infl.isConcurrent = isConcurrent;
+		infl.isBatchSampling = isBatchSampling;
+		infl.isCompressedRR = isCompressedRR;
+		infl.rrCacheDir = rrCacheDir;
 		//infl.Build(gf, maxK, cascade, eps, ell, mode);
 		// char rrinfl_simu_file[] = "GC_rr_imm_infl.txt";
 		// toSimulate(rrinfl_simu_file, IMM::GetNode, GeneralCascade::Run);
@@ -521,6 +626,9 @@ void MICommandLine::RRAlg(int argc, std::vector<std::string>& argv)
 		infl.kb_0= d_n;
 		infl.m_0 = a;
 		infl.isConcurrent = isConcurrent;
+		infl.isBatchSampling = isBatchSampling;
+		infl.isCompressedRR = isCompressedRR;
+		infl.rrCacheDir = rrCacheDir;
 		infl.Build(gf, maxK, time, cascade, eps, ell, mode);
 		// char rrinfl_simu_file[] = "GC_rr_imm_infl.txt";
 		// toSimulate(rrinfl_simu_file, IMM::GetNode, GeneralCascade::Run);
@@ -542,6 +650,9 @@ void MICommandLine::RRAlg(int argc, std::vector<std::string>& argv)
 		infl.kb_0 = d_n;
 		infl.m_0 = a;
 		infl.isConcurrent = isConcurrent;
+		infl.isBatchSampling = isBatchSampling;
+		infl.isCompressedRR = isCompressedRR;
+		infl.rrCacheDir = rrCacheDir;
 		infl._Build(gf, maxK, time, cascade, eps, ell, mode);
 		// char rrinfl_simu_file[] = "GC_rr_imm_infl.txt";
 		// toSimulate(rrinfl_simu_file, IMM::GetNode, GeneralCascade::Run);
@@ -0,0 +1,80 @@
+#ifndef mi_lazy_heap_h__
+#define mi_lazy_heap_h__
+
+#include <vector>
+#include <algorithm>
+
+
+/// Lazy max-heap for the greedy over weighted counts, where counts only decrease.
+/// The counts stay in the caller's array and every entry keeps the count it was pushed with.
+/// An entry whose count dropped since is refreshed only when it reaches the top,
+/// so a decrement costs nothing here and the top is always exact.
+class LazyMaxHeap
+{
+protected:
+	struct Entry
+	{
+		double count;
+		int id;
+	};
+
+	std::vector<Entry> heap;
+	/// which node wins a tie: the smallest id, or the largest one
+	bool isLargestIdFirst;
+
+	/// heap order: count, then id as set by isLargestIdFirst
+	struct EntryLess
+	{
+		bool isLargestIdFirst;
+		explicit EntryLess(bool isLargestIdFirst) : isLargestIdFirst(isLargestIdFirst) {}
+		bool operator () (const Entry& a, const Entry& b) const
+		{
+			if (a.count != b.count) return a.count < b.count;
+			return isLargestIdFirst ? a.id < b.id : a.id > b.id;
+		}
+	};
+
+public:
+	explicit LazyMaxHeap(bool isLargestIdFirst = false) : isLargestIdFirst(isLargestIdFirst) {}
+
+	bool empty() const { return heap.empty(); }
+
+	/// Queue the nodes first ... last with their counts
+	template <class TIter>
+	void Build(TIter first, TIter last, const std::vector<double>& counts)
+	{
+		heap.clear();
+		for (TIter it = first; it != last; ++it) {
+			Entry e;
+			e.count = counts[*it];
+			e.id = *it;
+			heap.push_back(e);
+		}
+		std::make_heap(heap.begin(), heap.end(), EntryLess(isLargestIdFirst));
+	}
+
+	/// The node of the largest count among the queued nodes with isCandidate[id] set, or -1 if none is left.
+	/// Queued nodes that are no candidates any more are dropped, so a node is removed by clearing its flag.
+	int Top(const std::vector<double>& counts, const std::vector<bool>& isCandidate)
+	{
+		EntryLess less(isLargestIdFirst);
+		while (!heap.empty()) {
+			Entry& e = heap.front();
+			if (!isCandidate[e.id]) {
+				std::pop_heap(heap.begin(), heap.end(), less);
+				heap.pop_back();
+				continue;
+			}
+			double c = counts[e.id];
+			if (c == e.count) return e.id;
+			// count dropped since e was pushed: sink it with its current count
+			std::pop_heap(heap.begin(), heap.end(), less);
+			heap.back().count = c;
+			std::push_heap(heap.begin(), heap.end(), less);
+		}
+		return -1;
+	}
+};
+
+
+#endif // mi_lazy_heap_h__
@@ -0,0 +1,113 @@
+#ifndef mi_scratch_h__
+#define mi_scratch_h__
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/// Reusable working space of one worker for graph traversals:
+/// a queue and an epoch-stamped visited array.
+/// Starting a traversal is O(1), the stamps are only cleared when the epoch wraps,
+/// so the cost of a traversal is proportional to the nodes and edges it touches.
+class TraversalScratch
+{
+protected:
+	std::vector<uint32_t> stamps;
+	uint32_t epoch;
+
+public:
+	/// BFS queue, also holds the visited nodes in visiting order
+	std::vector<int> queue;
+
+public:
+	TraversalScratch() : epoch(0) {}
+
+	/// Start a new traversal over a graph of n nodes: nothing is visited and the queue is empty
+	void Reset(int n)
+	{
+		if (stamps.size() != (size_t)n) {
+			stamps.assign(n, 0);
+			epoch = 0;
+		}
+		if (++epoch == 0) {
+			std::fill(stamps.begin(), stamps.end(), 0);
+			epoch = 1;
+		}
+		queue.clear();
+	}
+
+	bool IsVisited(int v) const { return stamps[v] == epoch; }
+
+	void Visit(int v) { stamps[v] = epoch; }
+};
+
+
+/// Index of the lowest set bit of a non-zero word
+inline int LowestBitIndex(uint64_t x)
+{
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward64(&idx, x);
+	return (int)idx;
+#else
+	return __builtin_ctzll(x);
+#endif
+}
+
+/// Number of set bits of a word
+inline int BitCount(uint64_t x)
+{
+#if defined(_MSC_VER)
+	return (int)__popcnt64(x);
+#else
+	return __builtin_popcountll(x);
+#endif
+}
+
+/// Working space of one worker for bit-parallel traversals of up to 64 samples:
+/// bit i of a node's mask stands for sample i.
+class BatchTraversalScratch
+{
+public:
+	/// node -> samples that reached it
+	std::vector<uint64_t> reached;
+	/// node -> samples that reached it but did not expand it yet
+	std::vector<uint64_t> pending;
+	/// nodes with pending samples
+	std::vector<int> queue;
+	/// nodes reached by any sample, in order of first touch
+	std::vector<int> touched;
+	/// per-sample output lists
+	std::vector< std::vector<int> > sets;
+
+public:
+	BatchTraversalScratch() : sets(64) {}
+
+	/// Start a new batch over a graph of n nodes. Only the nodes touched by the last batch are cleared.
+	void Reset(int n)
+	{
+		if (reached.size() != (size_t)n) {
+			reached.assign(n, 0);
+			pending.assign(n, 0);
+		}
+		else {
+			for (int v : touched) reached[v] = 0;
+		}
+		queue.clear();
+		touched.clear();
+	}
+
+	/// Mark v as reached by the samples in bits, and queue it for expansion
+	void Reach(int v, uint64_t bits)
+	{
+		if (reached[v] == 0) touched.push_back(v);
+		if (pending[v] == 0) queue.push_back(v);
+		reached[v] |= bits;
+		pending[v] |= bits;
+	}
+};
+
+#endif // mi_scratch_h__
@@ -9,6 +9,8 @@
 #include "common.h"
 #include "graph.h"
 #include "mi_random.h"
+#include "rr_pool.h"
+#include "mi_scratch.h"
 
 /// Container for RR set.
 typedef std::vector<int> RRVec;
@@ -27,12 +29,16 @@ public:
 protected:
 	int	n, m;
 	MIRandom random;
+	TraversalScratch scratch;
 	graph_type* gf;
 
 	
 
 public:
-	ReverseGCascadeT() : n(0), m(0), gf(NULL) {}
+	/// jump between activated in-edges of nodes with uniform probabilities (see GraphT::invLogFailW2)
+	bool isGeometricSkip;
+
+	ReverseGCascadeT() : n(0), m(0), gf(NULL), isGeometricSkip(true) {}
 
 public:
 	void Build(TGraph& gf)
@@ -46,6 +52,12 @@ public:
 	}
 
 	int GenRandomNode()
+	{
+		return GenRandomNode(random);
+	}
+
+	/// Thread-safe version: draws from the caller's own stream
+	int GenRandomNode(MIRandom& random)
 	{
 		int id = random.RandInt(0, n-1); // id: 0 ~ n-1
 		return id;
@@ -55,51 +67,32 @@ public:
 						std::vector< RRVec >& outRRSets,
                             int& outEdgeVisited)
 	{
-		// MI_STATIC_ASSERT(has_mem_GetNeighborCount<graph_type>::value, "graph_type should has member GetNeighbor");
-		// MI_STATIC_ASSERT(has_mem_GetEdge<graph_type>::value, "graph_type should has member GetEdge");
-		// MI_STATIC_ASSERT(has_mem_edgeForm<graph_type>::value, "graph_type should has member edgeForm");
+		int resultSize = 0;
+		outEdgeVisited = 0;
 
-		if (gf == NULL) {
-			throw NullPointerException("Please Build Graph first. (gf==NULL)");
+		for (int it=0; it<num_iter; it++)
+		{
+			resultSize += _ReverseBFS(target, outEdgeVisited, random, scratch);
+			outRRSets.push_back(scratch.queue);
 		}
+		return (double)resultSize / (double)num_iter;
+	}
 
-		int targetSize = 1;
+	/// Thread-safe version: appends the RR sets to a pool,
+	/// drawing from the caller's own stream and working in the caller's own scratch
+	double ReversePropagate(int num_iter, int target,
+						RRPool& outRRSets,
+						int& outEdgeVisited,
+						MIRandom& random,
+						TraversalScratch& scratch)
+	{
 		int resultSize = 0;
 		outEdgeVisited = 0;
-		ProbTransfom trans(gf->edgeForm);
 
 		for (int it=0; it<num_iter; it++)
 		{
-            std::vector<bool> active(n, false);
-			std::vector<int> RR;
-			RR.push_back(target);
-			active[target] = true;
-			resultSize ++;
-
-			int	h = 0;
-			int t = targetSize;
-
-			while (h<t) 
-			{
-				int k = gf->GetNeighborCount(RR[h]);
-				for (int i=0; i<k; i++)
-				{
-					auto& e = gf->GetEdge(RR[h], i);
-					// e = e(u, v), now RR[h] = u
-
-					if (active[e.v]) continue;
-					outEdgeVisited++;
-					if (random.RandBernoulli(trans.Prob(e.w2)))
-					{
-						RR.push_back(e.v);
-						active[e.v] = true;
-						t++;
-						resultSize++;
-					}
-				}
-				h++;
-			}
-			outRRSets.push_back(RR);
+			resultSize += _ReverseBFS(target, outEdgeVisited, random, scratch);
+			outRRSets.Append(scratch.queue.begin(), scratch.queue.end());
 		}
 		return (double)resultSize / (double)num_iter;
 	}
@@ -109,61 +102,126 @@ public:
 		int& outEdgeVisited,
 		int NodeNumber)
 	{
-		// MI_STATIC_ASSERT(has_mem_GetNeighborCount<graph_type>::value, "graph_type should has member GetNeighbor");
-		// MI_STATIC_ASSERT(has_mem_GetEdge<graph_type>::value, "graph_type should has member GetEdge");
-		// MI_STATIC_ASSERT(has_mem_edgeForm<graph_type>::value, "graph_type should has member edgeForm");
+		int resultSize = 0;
+		outEdgeVisited = 0;
 
-		if (gf == NULL) {
-			throw NullPointerException("Please Build Graph first. (gf==NULL)");
+		for (int it = 0; it < num_iter; it++)
+		{
+			resultSize += _ReverseBFS(target, outEdgeVisited, random, scratch);
+			std::pair< RRVec, int > RRWithTime;
+			RRWithTime.first = scratch.queue;
+			RRWithTime.second = random.RandInt(0, NodeNumber);
+			outRRSets.push_back(RRWithTime);
 		}
+		return (double)resultSize / (double)num_iter;
+	}
 
-		int targetSize = 1;
+	/// Thread-safe version: appends the RR sets to a pool, the time being the label of each set
+	double ReversePropagate(int num_iter, int target,
+		RRPool& outRRSets,
+		int& outEdgeVisited,
+		int NodeNumber,
+		MIRandom& random,
+		TraversalScratch& scratch)
+	{
 		int resultSize = 0;
 		outEdgeVisited = 0;
-		ProbTransfom trans(gf->edgeForm);
 
 		for (int it = 0; it < num_iter; it++)
 		{
-			std::vector<bool> active(n, false);
-			RRVec RR;
-			RR.push_back(target);
-			active[target] = true;
-			resultSize++;
+			resultSize += _ReverseBFS(target, outEdgeVisited, random, scratch);
+			outRRSets.Append(scratch.queue.begin(), scratch.queue.end(), random.RandInt(0, NodeNumber));
+		}
+		return (double)resultSize / (double)num_iter;
+	}
 
-			int	h = 0;
-			int t = targetSize;
+	/// Number of RR sets sampled together by ReversePropagateBatch, one bit of a word each
+	static const int BATCH_SIZE = 64;
+
+	/// Samples count (<= BATCH_SIZE) RR sets rooted at targets[0..count) in one bit-parallel traversal,
+	/// so the samples share the reads of the adjacency lists. The sets are appended to outRRSets in the
+	/// order of targets (labelled by labels[i] if labels != NULL); nodes within a set are not ordered.
+	/// outEdgeVisited[i] (if not NULL) gets the edges examined by sample i. Returns the total size.
+	int ReversePropagateBatch(const int* targets, int count,
+		RRPool& outRRSets,
+		int* outEdgeVisited,
+		MIRandom& random,
+		BatchTraversalScratch& scratch,
+		const int* labels = NULL)
+	{
+		if (gf == NULL) {
+			throw NullPointerException("Please Build Graph first. (gf==NULL)");
+		}
+		assert(count > 0 && count <= BATCH_SIZE);
 
-			while (h < t)
-			{
-				int k = gf->GetNeighborCount(RR[h]);
-				for (int i = 0; i < k; i++)
-				{
-					auto& e = gf->GetEdge(RR[h], i);
-					// e = e(u, v), now RR[h] = u
+		int edgeVisited[BATCH_SIZE] = { 0 };
+		scratch.Reset(n);
+		for (int i = 0; i < count; i++) {
+			scratch.Reach(targets[i], 1ULL << i);
+		}
 
-					if (active[e.v]) continue;
-					outEdgeVisited++;
-					if (random.RandBernoulli(trans.Prob(e.w2)))
+		for (size_t h = 0; h < scratch.queue.size(); h++)
+		{
+			int u = scratch.queue[h];
+			uint64_t mask = scratch.pending[u];
+			scratch.pending[u] = 0;
+			int k = gf->GetNeighborCount(u);
+			// see _ReverseBFS
+			for (uint64_t bits = mask; bits != 0; bits &= bits - 1) {
+				edgeVisited[LowestBitIndex(bits)] += k;
+			}
+			double invLogFail = gf->invLogFailW2[u];
+			if (isGeometricSkip && invLogFail != 0.0)
+			{
+				// see _ReverseBFS, each sample skips on its own
+				for (uint64_t bits = mask; bits != 0; bits &= bits - 1) {
+					int s = LowestBitIndex(bits);
+					uint64_t bit = 1ULL << s;
+					for (double i = random.RandSkip(invLogFail); i < k; i += 1.0 + random.RandSkip(invLogFail))
 					{
-						RR.push_back(e.v);
-						active[e.v] = true;
-						t++;
-						resultSize++;
+						int v = gf->GetEdge(u, (int)i).v;
+						if (scratch.reached[v] & bit) continue;
+						scratch.Reach(v, bit);
 					}
 				}
-				h++;
+				continue;
 			}
-			std::pair< RRVec, int > RRWithTime;
-			RRWithTime.first = RR;
-			RRWithTime.second = random.RandInt(0, NodeNumber); 
-			
-			outRRSets.push_back(RRWithTime);
-		}
-		return (double)resultSize / (double)num_iter;
-	}
-
 
+			for (int i = 0; i < k; i++)
+			{
+				auto& e = gf->GetEdge(u, i);
+				// flip the coin of e for every sample that reached u but not v
+				uint64_t candidates = mask & ~scratch.reached[e.v];
+				uint64_t hits = 0;
+				for (uint64_t bits = candidates; bits != 0; bits &= bits - 1) {
+					int s = LowestBitIndex(bits);
+					if (random.RandAccept(e.th2)) hits |= 1ULL << s;
+				}
+				if (hits != 0) scratch.Reach(e.v, hits);
+			}
+		}
 
+		// split the masks into the sets of each sample
+		int resultSize = 0;
+		for (int v : scratch.touched) {
+			for (uint64_t bits = scratch.reached[v]; bits != 0; bits &= bits - 1) {
+				scratch.sets[LowestBitIndex(bits)].push_back(v);
+			}
+		}
+		for (int i = 0; i < count; i++) {
+			std::vector<int>& RR = scratch.sets[i];
+			if (labels != NULL) {
+				outRRSets.Append(RR.begin(), RR.end(), labels[i]);
+			}
+			else {
+				outRRSets.Append(RR.begin(), RR.end());
+			}
+			if (outEdgeVisited != NULL) outEdgeVisited[i] = edgeVisited[i];
+			resultSize += (int)RR.size();
+			RR.clear();
+		}
+		return resultSize;
+	}
 
 	double ReversePropagate(int num_iter, int target,
                         std::vector< RRDVec >& outRRSets,
@@ -180,7 +238,6 @@ public:
 	    int targetSize = 1;
 	    int resultSize = 0;
 	    outEdgeVisited = 0;
-	    ProbTransfom trans(gf->edgeForm);
 
 	    for (int it=0; it<num_iter; it++)
 	    {
@@ -203,7 +260,7 @@ public:
 
 	                if (active[e.v]) continue;
 	                outEdgeVisited++;
-	                if (random.RandBernoulli(trans.Prob(e.w2)))
+	                if (random.RandAccept(e.th2))
 	                {
 	                    RR.push_back(std::pair<int, int>(e.v, RR[h].second + 1));
 	                    active[e.v] = true;
@@ -217,6 +274,61 @@ public:
 	    }
 	    return (double)resultSize / (double)num_iter;
 	}
+
+protected:
+	/// Samples one RR set rooted at target into scratch.queue.
+	/// Adds the in-edges of its nodes (its width) to edgeVisited and returns the size of the set.
+	int _ReverseBFS(int target, int& edgeVisited, MIRandom& random, TraversalScratch& scratch)
+	{
+		// MI_STATIC_ASSERT(has_mem_GetNeighborCount<graph_type>::value, "graph_type should has member GetNeighbor");
+		// MI_STATIC_ASSERT(has_mem_GetEdge<graph_type>::value, "graph_type should has member GetEdge");
+		// MI_STATIC_ASSERT(has_mem_edgeForm<graph_type>::value, "graph_type should has member edgeForm");
+
+		if (gf == NULL) {
+			throw NullPointerException("Please Build Graph first. (gf==NULL)");
+		}
+
+		scratch.Reset(n);
+		std::vector<int>& RR = scratch.queue;
+		RR.push_back(target);
+		scratch.Visit(target);
+
+		for (size_t h = 0; h < RR.size(); h++)
+		{
+			int u = RR[h];
+			int k = gf->GetNeighborCount(u);
+			// the width of the set (TIM): all in-edges of its nodes count as examined,
+			// including those to visited nodes, however the coins are drawn
+			edgeVisited += k;
+			double invLogFail = gf->invLogFailW2[u];
+			if (isGeometricSkip && invLogFail != 0.0)
+			{
+				// same coin for every edge: draw the gaps between successes instead
+				for (double i = random.RandSkip(invLogFail); i < k; i += 1.0 + random.RandSkip(invLogFail))
+				{
+					auto& e = gf->GetEdge(u, (int)i);
+					if (scratch.IsVisited(e.v)) continue;
+					RR.push_back(e.v);
+					scratch.Visit(e.v);
+				}
+				continue;
+			}
+
+			for (int i = 0; i < k; i++)
+			{
+				auto& e = gf->GetEdge(u, i);
+				// e = e(u, v)
+
+				if (scratch.IsVisited(e.v)) continue;
+				if (random.RandAccept(e.th2))
+				{
+					RR.push_back(e.v);
+					scratch.Visit(e.v);
+				}
+			}
+		}
+		return (int)RR.size();
+	}
 };
 
 typedef ReverseGCascadeT<Graph> ReverseGCascade;
@@ -8,6 +8,9 @@
 #include <cassert>
 
 #include "rr_infl.h"
+#include "mi_bucket_queue.h"
+#include "mi_lazy_heap.h"
+#include "mi_argmax.h"
 #include "reverse_general_cascade.h"
 #include "graph.h"
 #include "event_timer.h"
@@ -52,7 +55,50 @@ public:
 	}
 };
 
+/// MaskedArgMax picks the first of equal counts, as max_element with the comparators above
+static const bool IS_LAST_ON_TIES = false;
 
+/// Number of RR sets drawn from one RNG stream (independent of the thread count)
+static const size_t RR_BLOCK_SIZE = 1024;
+
+/// Number of covered samples per deduction chunk of the concurrent time-aware greedy
+static const size_t GREEDY_CHUNK_SIZE = 256;
+
+/// cover_round of a sample no seed covers yet, slice 0 is a round of its own
+static const int NOT_COVERED = -1;
+
+/// Append the per-thread buffers to ref in thread order. The offsets of the buffers
+/// are a prefix sum over their sizes, so every thread copies its own range without locking.
+template <class T>
+static void MergeThreadBuffers(std::vector< std::vector<T> >& buffers, std::vector<T>& ref)
+{
+	int nBuffers = (int)buffers.size();
+	vector<size_t> offsets(nBuffers + 1, ref.size());
+	for (int t = 0; t < nBuffers; ++t) {
+		offsets[t + 1] = offsets[t] + buffers[t].size();
+	}
+	ref.resize(offsets[nBuffers]);
+
+#pragma omp parallel for
+	for (int t = 0; t < nBuffers; ++t) {
+		std::move(buffers[t].begin(), buffers[t].end(), ref.begin() + offsets[t]);
+		std::vector<T>().swap(buffers[t]);
+	}
+}
+
+/// Mark the ids of list in the coverage bitset, one bit per RR set.
+/// Returns how many of them were not marked before
+static size_t CoverIds(const RRIndex::List& list, std::vector<uint64_t>& covered)
+{
+	size_t count = 0;
+	for (int idx : list) {
+		uint64_t& word = covered[(size_t)idx >> 6];
+		uint64_t bit = (uint64_t)1 << (idx & 63);
+		count += (word & bit) == 0;
+		word |= bit;
+	}
+	return count;
+}
 
 void RRInflBase::InitializeConcurrent()
 {
@@ -78,56 +124,138 @@ void RRInflBase::InitializeConcurrent()
 
 void RRInflBase::_AddRRSimulation(size_t num_iter, 
 							cascade_type& cascade, 
-							std::vector< RRVec >& refTable,
+							RRPool& refTable,
 							std::vector<int>& refTargets) 
 {
+	// serve the cached samples first, and store what is sampled beyond them
+	bool isCached = rrCache.Matches(0, 1, false);
+	if (isCached) {
+		num_iter -= rrCache.Take(num_iter, refTable, refTargets);
+		if (num_iter == 0) return;
+	}
+	size_t firstSet = refTable.size();
+	size_t firstTarget = refTargets.size();
+
 	vector<int> edgeVisited; // discard
 	_AddRRSimulation(num_iter, cascade, refTable, refTargets, edgeVisited);
+
+	if (isCached) rrCache.Put(refTable, firstSet, refTargets, firstTarget, sampleRound);
+}
+
+void RRInflBase::_OpenRRCache(graph_type& gf, int timeSlices, int setsPerSample, bool labelled)
+{
+	rrCache.Close();
+	if (rrCacheDir.empty()) return;
+
+	RRCache::Key key;
+	key.graphHash = RRCache::HashGraph(gf);
+	key.edgeForm = gf.edgeForm;
+	key.timeSlices = timeSlices;
+	key.seed = MIRandom::GetRunSeed();
+	key.setsPerSample = setsPerSample;
+	key.labelled = labelled ? 1 : 0;
+	key.batchSampling = isBatchSampling ? 1 : 0;
+	// continue after the rounds of the cached samples, so fresh samples use new streams
+	sampleRound = max(sampleRound, rrCache.Open(rrCacheDir, key));
+	if (rrCache.IsOpen()) {
+		cout << "  RR cache: " << rrCache.Path() << ", #samples = " << rrCache.SampleCount() << endl;
+	}
 }
 
 void RRInflBase::_AddRRSimulation(size_t num_iter, 
 							  cascade_type& cascade, 
-							  std::vector< RRVec >& refTable,
+							  RRPool& refTable,
 							  std::vector<int>& refTargets,
 							  std::vector<int>& refEdgeVisited)
 {
+	if (refTable.empty()) refTable.SetCompressed(isCompressedRR);
+	// Samples are cut into blocks of RR_BLOCK_SIZE, and each block draws from its own stream
+	// keyed by (run seed, round, block). So the table does not depend on the number of threads.
+	int round = sampleRound++;
+	int numBlocks = (int)((num_iter + RR_BLOCK_SIZE - 1) / RR_BLOCK_SIZE);
+
 #ifdef MI_USE_OMP
 	if (!isConcurrent) {
 #endif
 		// run single thread
 
-		for (size_t iter = 0; iter < num_iter; ++iter) {
-			int id = cascade.GenRandomNode();
-			int edgeVisited;
-			cascade.ReversePropagate(1, id, refTable, edgeVisited);
-
-			refTargets.push_back(id);
-			refEdgeVisited.push_back(edgeVisited);
+		TraversalScratch scratch;
+		BatchTraversalScratch batchScratch;
+		for (int block = 0; block < numBlocks; ++block) {
+			MIRandom random(MIRandom::StreamSeed(round, block));
+			size_t blockSize = min(num_iter - (size_t)block * RR_BLOCK_SIZE, RR_BLOCK_SIZE);
+			_AddRRBlock(blockSize, cascade, random, refTable, refTargets, refEdgeVisited, scratch, batchScratch);
 		}
 
 #ifdef MI_USE_OMP
 	} else {
-		// run concurrently
-		// #pragma omp parallel for private(iter, id, edge_visited_count, tmpTable) shared(refTable, refTargets, refEdgeVisited)
-
-		#pragma omp parallel for ordered
-		for (int iter = 0; iter < num_iter; ++iter) {
-			int id = cascade.GenRandomNode();
-			int edgeVisited;
-			vector<RRVec> tmpTable;
-			cascade.ReversePropagate(1, id, tmpTable, edgeVisited);
-			#pragma omp critical
-			{
-				refTable.push_back(tmpTable[0]);
-				refTargets.push_back(id);
-				refEdgeVisited.push_back(edgeVisited);
+		// run concurrently, each thread owns the stream of its block
+		// and appends into its own buffers, which are merged once at the end.
+		// static schedule keeps the blocks of a thread contiguous, so the merged table is in block order.
+		int nThreads = omp_get_max_threads();
+		vector<RRPool> localTables(nThreads, RRPool(refTable.IsCompressed()));
+		vector< vector<int> > localTargets(nThreads), localEdgeVisited(nThreads);
+
+#pragma omp parallel
+		{
+			int tid = omp_get_thread_num();
+			TraversalScratch scratch;
+			BatchTraversalScratch batchScratch;
+			RRPool& tmpTable = localTables[tid];
+			vector<int>& tmpTargets = localTargets[tid];
+			vector<int>& tmpEdgeVisited = localEdgeVisited[tid];
+
+#pragma omp for schedule(static)
+			for (int block = 0; block < numBlocks; ++block) {
+				MIRandom random(MIRandom::StreamSeed(round, block));
+				size_t blockSize = min(num_iter - (size_t)block * RR_BLOCK_SIZE, RR_BLOCK_SIZE);
+				_AddRRBlock(blockSize, cascade, random, tmpTable, tmpTargets, tmpEdgeVisited, scratch, batchScratch);
 			}
 		}
+
+		refTable.Concat(localTables);
+		MergeThreadBuffers(localTargets, refTargets);
+		MergeThreadBuffers(localEdgeVisited, refEdgeVisited);
 	}
 #endif
 
 }
 
+void RRInflBase::_AddRRBlock(size_t num_iter,
+	cascade_type& cascade,
+	MIRandom& random,
+	RRPool& refTable,
+	std::vector<int>& refTargets,
+	std::vector<int>& refEdgeVisited,
+	TraversalScratch& scratch,
+	BatchTraversalScratch& batchScratch)
+{
+	if (!isBatchSampling) {
+		for (size_t iter = 0; iter < num_iter; ++iter) {
+			int id = cascade.GenRandomNode(random);
+			int edgeVisited;
+			cascade.ReversePropagate(1, id, refTable, edgeVisited, random, scratch);
+
+			refTargets.push_back(id);
+			refEdgeVisited.push_back(edgeVisited);
+		}
+		return;
+	}
+
+	// draw the targets first, then traverse them BATCH_SIZE at a time
+	size_t firstTarget = refTargets.size();
+	size_t firstVisited = refEdgeVisited.size();
+	for (size_t iter = 0; iter < num_iter; ++iter) {
+		refTargets.push_back(cascade.GenRandomNode(random));
+	}
+	refEdgeVisited.resize(firstVisited + num_iter);
+	for (size_t iter = 0; iter < num_iter; iter += cascade_type::BATCH_SIZE) {
+		int count = (int)min((size_t)cascade_type::BATCH_SIZE, num_iter - iter);
+		cascade.ReversePropagateBatch(&refTargets[firstTarget + iter], count, refTable,
+			&refEdgeVisited[firstVisited + iter], random, batchScratch);
+	}
+}
+
 // Apply Greedy to solve Max Cover
 double RRInflBase::_RunGreedy(int seed_size,
 	vector<int>& outSeeds,
@@ -140,13 +268,15 @@ double RRInflBase::_RunGreedy(int seed_size,
 	vector<bool> enables;
 	enables.resize(table.size(), true);
 
-	set<int> candidates(sourceSet);
-	CountComparator comp(degrees);
+	// candidates bucketed by their counts, kept in step with the deductions below.
+	// ties go to the smallest id, as with CountComparator
+	BucketQueue candidates;
+	candidates.Build(sourceSet.begin(), sourceSet.end(), degrees);
 
 	double spread = 0;
 	for (int iter = 0; iter < seed_size; ++iter) {
-		set<int>::const_iterator maxPt = max_element(candidates.begin(), candidates.end(), comp);
-		int maxSource = *maxPt;
+		int maxSource = candidates.PopMax(degrees);
+		assert(maxSource >= 0);
 		// cout << "" << maxSource << "\t";
 		assert(degrees[maxSource] >= 0);
 
@@ -164,15 +294,14 @@ double RRInflBase::_RunGreedy(int seed_size,
 		outEstSpread.push_back(spread);
 
 		// clear values
-		candidates.erase(maxPt);
 		degrees[maxSource] = -1;
 
 		// deduct the counts from the rest nodes
-		const vector<int>& idxList = degreeRRIndices[maxSource];
+		RRIndex::List idxList = degreeRRIndices[maxSource];
 		if (!isConcurrent) {
 			for (int idx : idxList) {
 				if (enables[idx]) {
-					const RRVec& RRset = table[idx];
+					RRSpan RRset = table[idx];
 					for (int rr : RRset) {
 						if (rr == maxSource) continue;
 						degrees[rr]--; // deduct
@@ -183,11 +312,12 @@ double RRInflBase::_RunGreedy(int seed_size,
 		}
 		else {
 			// run concurrently
+			int idxCount = (int)idxList.size();
 #pragma omp parallel for
-			for (int idxIter = 0; idxIter < idxList.size(); ++idxIter) {
+			for (int idxIter = 0; idxIter < idxCount; ++idxIter) {
 				int idx = idxList[idxIter];
 				if (enables[idx]) {
-					const RRVec& RRset = table[idx];
+					RRSpan RRset = table[idx];
 					for (int rr : RRset) {
 						if (rr == maxSource) continue;
 
@@ -208,80 +338,143 @@ double RRInflBase::_RunGreedy(int seed_size,
 
 void RRInflBase::_RebuildRRIndices()
 {
-	degrees.clear();
-	degrees.resize(n, 0);
-	degreeRRIndices.clear();
-
-	for (int i = 0; i < n; ++i) {
-		degreeRRIndices.push_back(vector<int>());
-	}
-
 	// to count hyper edges:
-	for (size_t i = 0; i < table.size(); ++i) {
-		const RRVec& RR = table[i];
-		for (int source : RR) {
-			degrees[source]++;
-			degreeRRIndices[source].push_back(i); // add index of table
-		}
+	// the counts of the sets indexed before are kept, only the new sets are added
+	degreeRRIndices.Build(table, n, isConcurrent);
+	if (degreeRRIndices.FirstNewId() == 0) baseDegrees.assign(n, 0);
+	int added = (int)degreeRRIndices.AddedNodeCount();
+#pragma omp parallel for schedule(static) if(isConcurrent)
+	for (int i = 0; i < added; ++i) {
+		baseDegrees[degreeRRIndices.AddedNode(i)] += (int)degreeRRIndices.AddedCount(i);
 	}
-
-	// add to sourceSet where node's degree > 0
-	sourceSet.clear();
-	for (size_t i = 0; i < degrees.size(); ++i) {
-		if (degrees[i] >= 0) {
-			sourceSet.insert(i);
+	degrees = baseDegrees;
+
+	// add to sourceSet where node's degree > 0.
+	// the counts never drop below 0, so the set only changes with n
+	if (sourceSet.size() != (size_t)n) {
+		sourceSet.clear();
+		for (size_t i = 0; i < degrees.size(); ++i) {
+			if (degrees[i] >= 0) {
+				sourceSet.insert(i);
+			}
 		}
 	}
 }
 
 void IMM::_AddRRSimulation1(size_t num_iter,
 	cascade_type& cascade,
-	std::vector< std::vector< RRVec > >& refTable,
+	RRPool& refTable,
 	std::vector<int>& refTargets,
 	int k)
 {
+	if (refTable.empty()) refTable.SetCompressed(isCompressedRR);
+	timeSlices = k;
+	// serve the cached samples first, and store what is sampled beyond them
+	bool isCached = rrCache.Matches(k, k, false);
+	if (isCached) {
+		num_iter -= rrCache.Take(num_iter, refTable, refTargets);
+		if (num_iter == 0) return;
+	}
+	size_t firstSet = refTable.size();
+
+	// sampling runs over the 2-D grid of (target, slice) items rather than over targets,
+	// so a large k adds parallel work instead of serial work per target.
+	// item i*k+T is slice T of target i and lands in set i*k+T of refTable.
+	int targetRound = sampleRound++;
+	int sliceRound = sampleRound++;
+
+	// draw the targets first, block-keyed as in _AddRRSimulation
+	size_t firstTarget = refTargets.size();
+	refTargets.resize(firstTarget + num_iter);
+	int numTargetBlocks = (int)((num_iter + RR_BLOCK_SIZE - 1) / RR_BLOCK_SIZE);
+	for (int block = 0; block < numTargetBlocks; ++block) {
+		MIRandom random(MIRandom::StreamSeed(targetRound, block));
+		size_t first = (size_t)block * RR_BLOCK_SIZE;
+		size_t last = min(num_iter, first + RR_BLOCK_SIZE);
+		for (size_t iter = first; iter < last; ++iter) {
+			refTargets[firstTarget + iter] = cascade.GenRandomNode(random);
+		}
+	}
+	const int* targets = refTargets.data() + firstTarget;
+
+	size_t numItems = num_iter * k;
+	int numBlocks = (int)((numItems + RR_BLOCK_SIZE - 1) / RR_BLOCK_SIZE);
+	refTable.reserve(refTable.size() + numItems, refTable.NodeCount());
+
 #ifdef MI_USE_OMP
 	if (!isConcurrent) {
 #endif
 		// run single thread
 
-		for (size_t iter = 0; iter < num_iter; ++iter) {
-			int id = cascade.GenRandomNode();
-			int edgeVisited; //好像没用
-			std::vector< RRVec > tmpRefTable;
-			for (size_t i = 0; i < k; ++i) {
-				cascade.ReversePropagate(1, id, tmpRefTable, edgeVisited);
-			}
-			refTable.push_back(tmpRefTable);
-			//cascade.ReversePropagate(1, id, refTable, edgeVisited, k - 1); //refTable 就是tablewithtime，也就是返回的反向可达集pair的集合。
-
-			refTargets.push_back(id);
-			// refEdgeVisited.push_back(edgeVisited);
+		TraversalScratch scratch;
+		BatchTraversalScratch batchScratch;
+		for (int block = 0; block < numBlocks; ++block) {
+			MIRandom random(MIRandom::StreamSeed(sliceRound, block));
+			size_t first = (size_t)block * RR_BLOCK_SIZE;
+			size_t count = min(numItems - first, RR_BLOCK_SIZE);
+			_AddRRBlockWithTime(first, count, cascade, random, refTable, targets, k, scratch, batchScratch);
 		}
 
 #ifdef MI_USE_OMP
 	}
 	else {
-		// run concurrently
-		// #pragma omp parallel for private(iter, id, edge_visited_count, tmpTable) shared(refTable, refTargets, refEdgeVisited)
+		// run concurrently, each thread owns the stream of its item block.
+		// schedule(static) hands every thread a contiguous run of blocks, so concatenating
+		// the per-thread pools in thread order puts every set in its slot.
+		int nThreads = omp_get_max_threads();
+		std::vector<RRPool> localTables(nThreads, RRPool(refTable.IsCompressed()));
 
-#pragma omp parallel for ordered
-		for (int iter = 0; iter < num_iter; ++iter) {
-			int id = cascade.GenRandomNode();
-			int edgeVisited;
-			std::vector< RRVec > tmpRefTable;
-			for (size_t i = 0; i < k; ++i) {
-				cascade.ReversePropagate(1, id, tmpRefTable, edgeVisited);
-			}
-#pragma omp critical
-			{
-				refTable.push_back(tmpRefTable);
-				refTargets.push_back(id);
+#pragma omp parallel
+		{
+			int tid = omp_get_thread_num();
+			TraversalScratch scratch;
+			BatchTraversalScratch batchScratch;
+			RRPool& tmpTable = localTables[tid];
+
+#pragma omp for schedule(static)
+			for (int block = 0; block < numBlocks; ++block) {
+				MIRandom random(MIRandom::StreamSeed(sliceRound, block));
+				size_t first = (size_t)block * RR_BLOCK_SIZE;
+				size_t count = min(numItems - first, RR_BLOCK_SIZE);
+				_AddRRBlockWithTime(first, count, cascade, random, tmpTable, targets, k, scratch, batchScratch);
 			}
 		}
+
+		refTable.Concat(localTables);
 	}
 #endif
 
+	if (isCached) rrCache.Put(refTable, firstSet, refTargets, firstTarget, sampleRound);
+}
+
+void IMM::_AddRRBlockWithTime(size_t firstItem,
+	size_t count,
+	cascade_type& cascade,
+	MIRandom& random,
+	RRPool& refTable,
+	const int* targets,
+	int k,
+	TraversalScratch& scratch,
+	BatchTraversalScratch& batchScratch)
+{
+	if (!isBatchSampling) {
+		for (size_t item = firstItem; item < firstItem + count; ++item) {
+			int edgeVisited;
+			cascade.ReversePropagate(1, targets[item / k], refTable, edgeVisited, random, scratch);
+		}
+		return;
+	}
+
+	// the slices of a target are independent samples of the same root,
+	// so the items of a block are batched in order
+	std::vector<int> roots(count);
+	for (size_t i = 0; i < count; ++i) {
+		roots[i] = targets[(firstItem + i) / k];
+	}
+	for (size_t i = 0; i < count; i += cascade_type::BATCH_SIZE) {
+		int batch = (int)min((size_t)cascade_type::BATCH_SIZE, count - i);
+		cascade.ReversePropagateBatch(&roots[i], batch, refTable, NULL, random, batchScratch);
+	}
 }
 
 
@@ -289,38 +482,32 @@ void IMM::_RebuildRRIndicesWithTime()
 {
 	//RR_number.clear();
 	//RR_number.resize(top, 0);   //保存不同时间的反向可达集的数量
-	degreesWithTime.clear();
-	vector<double> temp(n);
-	degreesWithTime.resize(top, temp); //k's value  分别保存不同时间，不同节点的影响力扩展度。
-	degreeRRIndicesWithTime.clear();  //分别保存不同时间，不同节点cover的反向可达集
-	vector< vector<int> > temp1;
-	temp1.clear();
-	for (int i = 0; i < n; ++i) {
-		temp1.push_back(vector<int>());
-	}
-	degreeRRIndicesWithTime.resize(top, temp1);
-
-
-	// to count hyper edges:
-	for (size_t i = 0; i < tableWithTime.size(); ++i) {
-		const vector< RRVec >& RR = tableWithTime[i];
-		//RR_number[RR.second]++;
-#pragma omp parallel for ordered
-		for (int T = 0; T < RR.size(); T++) {
-			//double weight = 1.0 / (k_0 + m_0 * RR.second);
-			//double weight = 1.0;
-			//double weight = top - RR.second ;
-#pragma omp critical
-			for (int source : RR[T]) {
-				double weight = Weight_iter(weight_mode, T + 1);
-				degreesWithTime[T][source] += weight;
-				degreeRRIndicesWithTime[T][source].push_back(i); // add index of table
-			}
-			
+	// the indices are kept across rounds, so that Build only adds the samples appended since
+	degreeRRIndicesWithTime.resize(top);  //分别保存不同时间，不同节点cover的反向可达集
+	baseDegreesWithTime.resize(top);
+
+
+	// to count hyper edges: slice T of sample i is set i * timeSlices + T
+	size_t nSamples = _SampleCountWithTime();
+	for (int T = 0; T < top; T++) {
+		RRIndex& index = degreeRRIndicesWithTime[T];
+		index.Build(tableWithTime, n, T, timeSlices, (T < timeSlices) ? nSamples : 0, isConcurrent);
+		// the weight is added once per new set, as the greedy deducts it
+		double weight = Weight_iter(weight_mode, T + 1);
+		vector<double>& counts = baseDegreesWithTime[T];
+		if (index.FirstNewId() == 0) counts.assign(n, 0.0);
+		int added = (int)index.AddedNodeCount();
+#pragma omp parallel for schedule(static) if(isConcurrent)
+		for (int i = 0; i < added; ++i) {
+			double& count = counts[index.AddedNode(i)];
+			for (size_t c = index.AddedCount(i); c > 0; --c) count += weight;
 		}
 	}
+	degreesWithTime = baseDegreesWithTime; //k's value  分别保存不同时间，不同节点的影响力扩展度。
 
-	// add to sourceSet where node's degree > 0
+	// add to sourceSet where node's degree > 0.
+	// the counts never drop below 0, so the sets only change with the slices
+	if (sourceSetWithTime.size() == degreesWithTime.size() * n && sourceSet.size() == (size_t)n) return;
 	sourceSetWithTime.clear(); //
 	sourceSet.clear();
 	for (size_t i = 0; i < degreesWithTime.size(); ++i) {
@@ -338,33 +525,72 @@ void IMM::_RebuildRRIndicesWithTime()
 	}
 }
 
+vector<double> IMM::EstimateSchedules(const vector< vector< pair<int, int> > >& schedules)
+{
+	// the samples are read from tableWithTime in one pass, the indices and counts of the greedy are left alone
+	size_t nSamples = _SampleCountWithTime();
+	vector<double> spreads(schedules.size(), 0.0);
+	if (nSamples == 0) return spreads;
+
+	// seeds of later slices cover no sample
+	int nSlices = min(top, timeSlices);
+	int nSchedules = (int)schedules.size();
+	vector< vector< pair<int, int> > > seedsOf(n); // (slice, schedule) of the seeds at each node
+	for (int s = 0; s < nSchedules; ++s) {
+		for (const pair<int, int>& sd : schedules[s]) {
+			if (sd.second < 0 || sd.second >= nSlices || sd.first < 0 || sd.first >= n) continue;
+			seedsOf[sd.first].push_back(make_pair(sd.second, s));
+		}
+	}
+
+	// covered[s * nSlices + T]: samples that schedule s covers first in slice T
+	vector<size_t> covered((size_t)nSchedules * nSlices, 0);
+	int nSampleCount = (int)nSamples;
+#pragma omp parallel if(isConcurrent)
+	{
+		// a sample counts once per schedule: lastSample[s] is the last one counted for s
+		vector<size_t> counts(covered.size(), 0);
+		vector<int> lastSample(nSchedules, -1);
+#pragma omp for schedule(static)
+		for (int i = 0; i < nSampleCount; ++i) {
+			// slices in time order, so a sample counts for the earliest slice covering it
+			for (int T = 0; T < nSlices; ++T) {
+				for (int v : tableWithTime[(size_t)i * timeSlices + T]) {
+					for (const pair<int, int>& sd : seedsOf[v]) {
+						if (sd.first != T || lastSample[sd.second] == i) continue;
+						lastSample[sd.second] = i;
+						counts[(size_t)sd.second * nSlices + T]++;
+					}
+				}
+			}
+		}
+#pragma omp critical
+		for (size_t c = 0; c < covered.size(); ++c) covered[c] += counts[c];
+	}
+	for (int s = 0; s < nSchedules; ++s) {
+		double weighted = 0;
+		for (int T = 0; T < nSlices; ++T) {
+			weighted += Weight_iter(weight_mode, T + 1) * covered[(size_t)s * nSlices + T];
+		}
+		spreads[s] = (double)n * weighted / nSamples;
+	}
+	return spreads;
+}
+
 void IMM::_RebuildRRIndicesWithReuse()
 {
 	degreesWithTime.clear();
 	vector<double> temp(n);
 	degreesWithTime.resize(max_time, temp); //k's value  分别保存不同时间，不同节点的影响力扩展度。
-	degreeRRIndicesWithTime.clear();  //分别保存不同时间，不同节点cover的反向可达集
-	vector< vector<int> > temp1;
-	temp1.clear();
-	for (int i = 0; i < n; ++i) {
-		temp1.push_back(vector<int>());
-	}
-	degreeRRIndicesWithTime.resize(max_time, temp1);
+	degreeRRIndicesWithTime.resize(max_time);  //分别保存不同时间，不同节点cover的反向可达集
 
 
-	// to count hyper edges:
-	for (size_t i = 0; i < table.size(); ++i) {
-		const RRVec& RR = table[i];
-		for (int source : RR) {
-			//double weight = 1.0 / (k_0 + m_0 * RR.second);
-			//double weight = 1.0;
-			//double weight = top - RR.second ;
-			//double weight = Weight_iter(weight_mode, 0 + 1);
-			degreesWithTime[0][source] += 1;
-			degreeRRIndicesWithTime[0][source].push_back(i); // add index of table
-		}
-	}
+	// to count hyper edges: slice 0 shares the index of table, which only adds the new sets
+	_RebuildRRIndices();
+	degreeRRIndicesWithTime[0] = degreeRRIndices;
+	degreesWithTime[0].assign(baseDegrees.begin(), baseDegrees.end());
 
+	// every slice deducts its own counts, while the lists of slice 0 are shared by all slices
 	for (int j = 1; j < max_time; j++)
 	{
 		degreesWithTime[j] = degreesWithTime[0];
@@ -373,7 +599,9 @@ void IMM::_RebuildRRIndicesWithReuse()
 	}
 
 
-	// add to sourceSet where node's degree > 0
+	// add to sourceSet where node's degree > 0.
+	// the counts never drop below 0, so the sets only change with the slices
+	if (sourceSetWithTime.size() == degreesWithTime.size() * n && sourceSet.size() == (size_t)n) return;
 	sourceSetWithTime.clear(); //
 	sourceSet.clear();
 	for (size_t i = 0; i < degreesWithTime.size(); ++i) {
@@ -399,49 +627,45 @@ double IMM::_RunGreedy1(int seed_size,
 	outEstSpread.clear();
 
 	// set enables for table
+	size_t nSamples = _SampleCountWithTime();
 	vector<bool> enables;
-	enables.resize(tableWithTime.size(), true);
+	enables.resize(nSamples, true);
 	vector<int> cover_round;
-	cover_round.resize(tableWithTime.size(), 0);
+	cover_round.resize(nSamples, NOT_COVERED);
 
-	set<int> candidates(sourceSet);
-	vector<set<int>> candidatesWithTime(top, candidates);
-	// dCountComparator comp(degreesWithTime[0]);  //edited
-	vector<dCountComparator> camp;
+	// per time slice, the candidates in a heap over their weighted counts, which the deductions
+	// below only lower. ties go to the smallest id within a slice and to the latest slice
+	// across slices, as with dCountComparator and PairdCountComparator
+	vector<vector<bool>> isCandidateWithTime(top, vector<bool>(n, false));
+	vector<LazyMaxHeap> candidatesWithTime(top);
 	for (int i = 0; i < top; i++) {
-		dCountComparator comp(degreesWithTime[i]);
-		camp.push_back(comp);
+		for (int v : sourceSet) isCandidateWithTime[i][v] = true;
+		candidatesWithTime[i].Build(sourceSet.begin(), sourceSet.end(), degreesWithTime[i]);
 	}
 
+	// deductions of the concurrent path, per chunk of covered samples and per slice
+	vector< vector< vector< pair<int, double> > > > chunkDeltas;
+
 	double spread = 0;
 	for (int iter = 0; iter < seed_size; ++iter) {
-		vector<pair<pair<double, int>, int>> winner; //记录每个时间上最大的节点
+		pair<int, int> maxSourceWithTime(-1, -1);
 		for (int i = 0; i < top; i++) {
-			set<int>::const_iterator maxPtIn = max_element(candidatesWithTime[i].begin(), candidatesWithTime[i].end(), camp[i]);
-			pair<pair<double, int>, int> maxSource;
-			maxSource.first.second = *maxPtIn;
-			maxSource.first.first = degreesWithTime[i][*maxPtIn];
-			maxSource.second = i;
-			winner.push_back(maxSource);
-		}
-		PairdCountComparator comp_end(winner);
-		set<int> Timecandidates;
-		for (int i = 0; i < top; i++)
-		{
-			Timecandidates.insert(i);
+			int v = candidatesWithTime[i].Top(degreesWithTime[i], isCandidateWithTime[i]);
+			if (v < 0) continue;
+			if (maxSourceWithTime.first < 0 || degreesWithTime[i][v] >= degreesWithTime[maxSourceWithTime.second][maxSourceWithTime.first]) {
+				maxSourceWithTime.first = v; // node id
+				maxSourceWithTime.second = i; // time
+			}
 		}
-		set<int>::const_iterator maxPt = max_element(Timecandidates.begin(), Timecandidates.end(), comp_end);
-		pair<int, int> maxSourceWithTime;
-		maxSourceWithTime.first = winner[*maxPt].first.second; // node id
-		maxSourceWithTime.second = winner[*maxPt].second; // time
 		// cout << "" << maxSource << "\t";
-		assert(degreesWithTime[winner[*maxPt].second][maxSourceWithTime.first] >= 0);
+		assert(maxSourceWithTime.first >= 0);
+		assert(degreesWithTime[maxSourceWithTime.second][maxSourceWithTime.first] >= 0);
 
 		// selected one node
 		outSeeds.push_back(maxSourceWithTime);
 
 		// estimate spread
-		spread = spread + ((double)n * degreesWithTime[maxSourceWithTime.second][maxSourceWithTime.first] / tableWithTime.size());
+		spread = spread + ((double)n * degreesWithTime[maxSourceWithTime.second][maxSourceWithTime.first] / nSamples);
 
 		// if (iter==0)
 		// {
@@ -451,66 +675,67 @@ double IMM::_RunGreedy1(int seed_size,
 		outEstSpread.push_back(spread);
 
 		// clear values
-		candidatesWithTime[maxSourceWithTime.second].erase(maxSourceWithTime.first);   //把选中的节点从预备节点中移除
+		isCandidateWithTime[maxSourceWithTime.second][maxSourceWithTime.first] = false;   //把选中的节点从预备节点中移除
 		//degreesWithTime[maxSourceWithTime.second][maxSourceWithTime.first] = -1;   似乎是多此一举
 
 		// deduct the counts from the rest nodes
-		const vector<int>& idxList = degreeRRIndicesWithTime[maxSourceWithTime.second][maxSourceWithTime.first];
+		RRIndex::List idxList = degreeRRIndicesWithTime[maxSourceWithTime.second][maxSourceWithTime.first];
 		if (isConcurrent) {
-			int count = 0;
-			for (int idx : idxList) {
-				if (cover_round[idx]==0) {
-					cover_round[idx] = maxSourceWithTime.second;
-					const vector<RRVec>& RRset = tableWithTime[idx];
-#pragma omp parallel for ordered
-					for (int T = 0; T < RRset.size();T++) {
-						for (int node : RRset[T]) {
-							if (node == maxSourceWithTime.first && T == maxSourceWithTime.second) continue;
-#pragma omp critical
-							if (T < maxSourceWithTime.second) {
-								count++;
-								degreesWithTime[T][node] -= Weight_iter(weight_mode, maxSourceWithTime.second + 1);
-							}
-							else {
-								degreesWithTime[T][node] -= Weight_iter(weight_mode, T + 1); // deduct
-							}
-						}
-						
-					}
-					
-				}
-				else if (cover_round[idx] > maxSourceWithTime.second) {
+			// the covered samples are split into fixed chunks, and every chunk lists its deductions per
+			// slice in sample order. the lists are then applied slice by slice in chunk order, so the
+			// counts come out exactly as in the serial deduction, whatever the number of threads
+			const int selNode = maxSourceWithTime.first;
+			const int selTime = maxSourceWithTime.second;
+			int nChunks = (int)((idxList.size() + GREEDY_CHUNK_SIZE - 1) / GREEDY_CHUNK_SIZE);
+			if ((int)chunkDeltas.size() < nChunks) {
+				chunkDeltas.resize(nChunks, vector< vector< pair<int, double> > >(timeSlices));
+			}
+#pragma omp parallel for schedule(static)
+			for (int c = 0; c < nChunks; ++c) {
+				vector< vector< pair<int, double> > >& deltas = chunkDeltas[c];
+				for (int T = 0; T < timeSlices; T++) deltas[T].clear();
+				size_t last = min(idxList.size(), (size_t)(c + 1) * GREEDY_CHUNK_SIZE);
+				for (size_t j = (size_t)c * GREEDY_CHUNK_SIZE; j < last; ++j) {
+					int idx = idxList[j];
 					int old_round = cover_round[idx];
-					cover_round[idx] = maxSourceWithTime.second;
-					const vector<RRVec>& RRset = tableWithTime[idx];
-#pragma omp parallel for ordered
-					for (int T = 0; T < RRset.size(); T++) {
-						for (int node : RRset[T]) {
-							if (node == maxSourceWithTime.first && T == maxSourceWithTime.second) continue;
-#pragma omp critical
-							if (T < maxSourceWithTime.second) {
-								count++;
-								degreesWithTime[T][node] -= Weight_iter(weight_mode, maxSourceWithTime.second + 1) - Weight_iter(weight_mode, old_round + 1);
-							}
-							else if(old_round > T){
-								degreesWithTime[T][node] -= Weight_iter(weight_mode, T + 1) - Weight_iter(weight_mode, old_round + 1);
-							}
+					if (old_round != NOT_COVERED && old_round <= selTime) continue;
+					cover_round[idx] = selTime;
+					for (int T = 0; T < timeSlices; T++) {
+						double delta;
+						if (old_round == NOT_COVERED) {
+							delta = Weight_iter(weight_mode, (T < selTime ? selTime : T) + 1);
+						}
+						else if (T < selTime) {
+							delta = Weight_iter(weight_mode, selTime + 1) - Weight_iter(weight_mode, old_round + 1);
+						}
+						else if (old_round > T) {
+							delta = Weight_iter(weight_mode, T + 1) - Weight_iter(weight_mode, old_round + 1);
+						}
+						else continue;
+						for (int node : tableWithTime[(size_t)idx * timeSlices + T]) {
+							if (node == selNode && T == selTime) continue;
+							deltas[T].push_back(make_pair(node, delta));
 						}
-
 					}
 				}
-				if(count == 0) enables[idx] = false;
+			}
+			// a slice only takes its own deductions, so the slices are reduced in parallel
+#pragma omp parallel for schedule(static)
+			for (int T = 0; T < timeSlices; T++) {
+				vector<double>& counts = degreesWithTime[T];
+				for (int c = 0; c < nChunks; ++c) {
+					for (const pair<int, double>& d : chunkDeltas[c][T]) counts[d.first] -= d.second;
+				}
 			}
 		}
 		else {
 			int count = 0;
 			for (int idx : idxList) {
-				if (cover_round[idx] == 0) {
+				if (cover_round[idx] == NOT_COVERED) {
 					cover_round[idx] = maxSourceWithTime.second;
-					const vector<RRVec>& RRset = tableWithTime[idx];
 #pragma omp parallel for ordered
-					for (int T = 0; T < RRset.size(); T++) {
-						for (int node : RRset[T]) {
+					for (int T = 0; T < timeSlices; T++) {
+						for (int node : tableWithTime[(size_t)idx * timeSlices + T]) {
 							if (node == maxSourceWithTime.first && T == maxSourceWithTime.second) continue;
 #pragma omp critical
 							if (T < maxSourceWithTime.second) {
@@ -528,10 +753,9 @@ double IMM::_RunGreedy1(int seed_size,
 				else if (cover_round[idx] > maxSourceWithTime.second) {
 					int old_round = cover_round[idx];
 					cover_round[idx] = maxSourceWithTime.second;
-					const vector<RRVec>& RRset = tableWithTime[idx];
 #pragma omp parallel for ordered
-					for (int T = 0; T < RRset.size(); T++) {
-						for (int node : RRset[T]) {
+					for (int T = 0; T < timeSlices; T++) {
+						for (int node : tableWithTime[(size_t)idx * timeSlices + T]) {
 							if (node == maxSourceWithTime.first && T == maxSourceWithTime.second) continue;
 #pragma omp critical
 							if (T < maxSourceWithTime.second) {
@@ -585,7 +809,7 @@ double IMM::_RunGreedyTest(int seed_size,
 
 	// set enables for table
 	vector<bool> enables;
-	enables.resize(tableWithTime.size(), true);
+	enables.resize(_SampleCountWithTime(), true);
 
 	set<int> candidates(sourceSet);
 	// dCountComparator comp(degreesWithTime[0]);  //edited
@@ -640,7 +864,7 @@ double IMM::_RunGreedyTest(int seed_size,
 
 		// deduct the counts from the rest nodes
 		/*
-		const vector<int>& idxList = degreeRRIndicesWithTime[maxSourceWithTime.second][maxSourceWithTime.first];
+		RRIndex::List idxList = degreeRRIndicesWithTime[maxSourceWithTime.second][maxSourceWithTime.first];
 		if (!isConcurrent) {
 			for (int idx : idxList) {
 				if (enables[idx]) {
@@ -780,13 +1004,14 @@ double IMM::FindTopK(int seed_size,
 	vector<bool> enables;
 	enables.resize(table.size(), true);
 
-	set<int> candidates(sourceSet);
-	CountComparator comp(degrees);
+	// candidates as a dense mask over the node ids, scanned by MaskedArgMax
+	vector<uint8_t> isCandidate(n, 0);
+	for (int v : sourceSet) isCandidate[v] = 1;
 
 	double spread = 0;
 	for (int iter = 0; iter < seed_size; ++iter) {
-		set<int>::const_iterator maxPt = max_element(candidates.begin(), candidates.end(), comp);
-		int maxSource = *maxPt;
+		int maxSource = MaskedArgMax(degrees.data(), isCandidate.data(), n, IS_LAST_ON_TIES);
+		assert(maxSource >= 0);
 		// cout << "" << maxSource << "\t";
 		assert(degrees[maxSource] >= 0);
 
@@ -807,7 +1032,7 @@ double IMM::FindTopK(int seed_size,
 		outEstSpread.push_back(spread);
 
 		// clear values
-		candidates.erase(maxPt);
+		isCandidate[maxSource] = 0;
 		degrees[maxSource] = -1;
 
 		// deduct the counts from the rest nodes
@@ -833,12 +1058,13 @@ double IMM::uniformChoose(int seed_size,
 
 
 
-	set<int> candidates(sourceSet);
+	// candidates as a dense mask over the node ids, scanned by MaskedArgMax
+	vector<uint8_t> isCandidate(n, 0);
+	for (int v : sourceSet) isCandidate[v] = 1;
 	//CountComparator comp(degrees);
 
 	double spread = 0;
 	for (int iter = 0; iter < max_time; ++iter) {
-		dCountComparator comp(degreesWithTime[iter]);
 		if (iter < more_number)
 		{
 			// set enables for table
@@ -847,8 +1073,8 @@ double IMM::uniformChoose(int seed_size,
 			for (int j = 0; j < more; j++)
 			{
 
-				set<int>::const_iterator maxPt = max_element(candidates.begin(), candidates.end(), comp);
-				int maxSource = *maxPt;
+				int maxSource = MaskedArgMax(degreesWithTime[iter].data(), isCandidate.data(), n, IS_LAST_ON_TIES);
+				assert(maxSource >= 0);
 				// cout << "" << maxSource << "\t";
 				assert(degreesWithTime[iter][maxSource] >= 0);
 
@@ -869,15 +1095,15 @@ double IMM::uniformChoose(int seed_size,
 				outEstSpread.push_back(spread);
 
 				// clear values
-				candidates.erase(maxSource);
+				isCandidate[maxSource] = 0;
 				degreesWithTime[iter][maxSource] = -1;
 
 				// deduct the counts from the rest nodes
-				const vector<int>& idxList = degreeRRIndicesWithTime[iter][maxSource];
+				RRIndex::List idxList = degreeRRIndicesWithTime[iter][maxSource];
 				if (!isConcurrent) {
 					for (int idx : idxList) {
 						if (enables[idx]) {
-							const RRVec& RRset = table[idx];
+							RRSpan RRset = table[idx];
 							for (int rr : RRset) {
 								if (rr == maxSource) continue;
 								degreesWithTime[iter][rr] -= 1; // deduct
@@ -888,11 +1114,12 @@ double IMM::uniformChoose(int seed_size,
 				}
 				else {
 					// run concurrently
+					int idxCount = (int)idxList.size();
 #pragma omp parallel for
-					for (int idxIter = 0; idxIter < idxList.size(); ++idxIter) {
+					for (int idxIter = 0; idxIter < idxCount; ++idxIter) {
 						int idx = idxList[idxIter];
 						if (enables[idx]) {
-							const RRVec& RRset = table[idx];
+							RRSpan RRset = table[idx];
 							for (int rr : RRset) {
 								if (rr == maxSource) continue;
 
@@ -913,8 +1140,8 @@ double IMM::uniformChoose(int seed_size,
 			for (int j = 0; j < less; j++)
 			{
 
-				set<int>::const_iterator maxPt = max_element(candidates.begin(), candidates.end(), comp);
-				int maxSource = *maxPt;
+				int maxSource = MaskedArgMax(degreesWithTime[iter].data(), isCandidate.data(), n, IS_LAST_ON_TIES);
+				assert(maxSource >= 0);
 				// cout << "" << maxSource << "\t";
 				assert(degreesWithTime[iter][maxSource] >= 0);
 
@@ -935,15 +1162,15 @@ double IMM::uniformChoose(int seed_size,
 				outEstSpread.push_back(spread);
 
 				// clear values
-				candidates.erase(maxSource);
+				isCandidate[maxSource] = 0;
 				degreesWithTime[iter][maxSource] = -1;
 
 				// deduct the counts from the rest nodes
-				const vector<int>& idxList = degreeRRIndicesWithTime[iter][maxSource];
+				RRIndex::List idxList = degreeRRIndicesWithTime[iter][maxSource];
 				if (!isConcurrent) {
 					for (int idx : idxList) {
 						if (enables[idx]) {
-							const RRVec& RRset = table[idx];
+							RRSpan RRset = table[idx];
 							for (int rr : RRset) {
 								if (rr == maxSource) continue;
 								degreesWithTime[iter][rr] -= 1; // deduct
@@ -954,11 +1181,12 @@ double IMM::uniformChoose(int seed_size,
 				}
 				else {
 					// run concurrently
+					int idxCount = (int)idxList.size();
 #pragma omp parallel for
-					for (int idxIter = 0; idxIter < idxList.size(); ++idxIter) {
+					for (int idxIter = 0; idxIter < idxCount; ++idxIter) {
 						int idx = idxList[idxIter];
 						if (enables[idx]) {
-							const RRVec& RRset = table[idx];
+							RRSpan RRset = table[idx];
 							for (int rr : RRset) {
 								if (rr == maxSource) continue;
 
@@ -986,7 +1214,9 @@ double IMM::reuseRunGreedy(int seed_size,
 	outSeeds.clear();
 	outEstSpread.clear();
 
-	set<int> candidates(sourceSet);
+	// candidates as a dense mask over the node ids, scanned by MaskedArgMax
+	vector<uint8_t> isCandidate(n, 0);
+	for (int v : sourceSet) isCandidate[v] = 1;
 	double spread = 0;
 	int seed_size_temp = 0;
 	seed_size_temp = seed_size;
@@ -1001,14 +1231,13 @@ double IMM::reuseRunGreedy(int seed_size,
 	}
 	for (int iter = 0; iter < max_time; iter++)
 	{
-		dCountComparator comp(degreesWithTime[iter]);
 		// set enables for table
 		vector<bool> enables;
 		enables.resize(table.size(), true);
 		for (int j = 0; j < seize_size[iter]; j++)
 		{
-			set<int>::const_iterator maxPt = max_element(candidates.begin(), candidates.end(), comp);
-			int maxSource = *maxPt;
+			int maxSource = MaskedArgMax(degreesWithTime[iter].data(), isCandidate.data(), n, IS_LAST_ON_TIES);
+			assert(maxSource >= 0);
 			// cout << "" << maxSource << "\t";
 			assert(degreesWithTime[iter][maxSource] >= 0);
 
@@ -1029,15 +1258,15 @@ double IMM::reuseRunGreedy(int seed_size,
 			outEstSpread.push_back(spread);
 
 			// clear values
-			candidates.erase(maxPt);
+			isCandidate[maxSource] = 0;
 			degreesWithTime[iter][maxSource] = -1;
 
 			// deduct the counts from the rest nodes
-			const vector<int>& idxList = degreeRRIndicesWithTime[iter][maxSource];
+			RRIndex::List idxList = degreeRRIndicesWithTime[iter][maxSource];
 			if (!isConcurrent) {
 				for (int idx : idxList) {
 					if (enables[idx]) {
-						const RRVec& RRset = table[idx];
+						RRSpan RRset = table[idx];
 						for (int rr : RRset) {
 							if (rr == maxSource) continue;
 							degreesWithTime[iter][rr] -= 1; // deduct
@@ -1048,11 +1277,12 @@ double IMM::reuseRunGreedy(int seed_size,
 			}
 			else {
 				// run concurrently
+				int idxCount = (int)idxList.size();
 #pragma omp parallel for
-				for (int idxIter = 0; idxIter < idxList.size(); ++idxIter) {
+				for (int idxIter = 0; idxIter < idxCount; ++idxIter) {
 					int idx = idxList[idxIter];
 					if (enables[idx]) {
-						const RRVec& RRset = table[idx];
+						RRSpan RRset = table[idx];
 						for (int rr : RRset) {
 							if (rr == maxSource) continue;
 
@@ -1161,25 +1391,58 @@ void IMM::_SetResults1(const vector<pair<int, int>>& seeds, const vector<double>
 // Same thing has been implemented as a part of _Greedy
 double RRInflBase::_EstimateInfl(const vector<int>& seeds, vector<double>& out_cumu_spread)
 {
-	set<int> covered;
+	vector<uint64_t> covered((table.size() + 63) / 64, 0);
+	size_t coveredCount = 0;
 	double spd = 0;
 
-	vector<bool> enables;
-	enables.resize(table.size(), true);
 	for (size_t i = 0; i < seeds.size(); ++i) {
-		int sd = seeds[i];
-		for (int idx : degreeRRIndices[sd]) {
-			if (enables[idx]) {
-				covered.insert(idx);
-				enables[idx] = false;
-			}
-		}
-		spd = (double)(n * covered.size()) / table.size();
+		coveredCount += CoverIds(degreeRRIndices[seeds[i]], covered);
+		spd = (double)(n * coveredCount) / table.size();
 		out_cumu_spread.push_back(spd);
 	}
 	return spd;
 }
 
+vector<double> RRInflBase::EstimateSpreads(const vector< vector<int> >& seedSets)
+{
+	// the RR sets are read from table in one pass, the indices and counts of the greedy are left alone
+	vector<double> spreads(seedSets.size(), 0.0);
+	if (table.empty()) return spreads;
+
+	int nSets = (int)seedSets.size();
+	vector< vector<int> > setsOf(n); // the seed sets holding each node
+	for (int s = 0; s < nSets; ++s) {
+		for (int sd : seedSets[s]) {
+			if (sd >= 0 && sd < n) setsOf[sd].push_back(s);
+		}
+	}
+
+	vector<size_t> covered(nSets, 0);
+	int nRR = (int)table.size();
+#pragma omp parallel if(isConcurrent)
+	{
+		// an RR set counts once per seed set: lastRR[s] is the last one counted for s
+		vector<size_t> counts(nSets, 0);
+		vector<int> lastRR(nSets, -1);
+#pragma omp for schedule(static)
+		for (int i = 0; i < nRR; ++i) {
+			for (int v : table[i]) {
+				for (int s : setsOf[v]) {
+					if (lastRR[s] == i) continue;
+					lastRR[s] = i;
+					counts[s]++;
+				}
+			}
+		}
+#pragma omp critical
+		for (int s = 0; s < nSets; ++s) covered[s] += counts[s];
+	}
+	for (int s = 0; s < nSets; ++s) {
+		spreads[s] = (double)(n * covered[s]) / table.size();
+	}
+	return spreads;
+}
+
 
 
 ////////////////////////////////////////////////////////////////////
@@ -1457,6 +1720,7 @@ void IMM::_Build(graph_type& gf, int k, int time, cascade_type& cascade, double
 
 	table.clear();
 	targets.clear();
+	_OpenRRCache(gf, 0, 1, false);
 
 	double epsprime = eps * sqrt(2.0); // eps'
 	double LB = 1.0;   // lower bound
@@ -1596,6 +1860,7 @@ void IMM::_Build(graph_type& gf, int k, int time, cascade_type& cascade, double
 		stept.SetTimeEvent("step_end");
 		steptimers.push_back(stept);
 	}
+	rrCache.Close();
 	pctimer.SetTimeEvent("end");
 
 	// Write results to file:
@@ -1643,6 +1908,7 @@ void IMM::Build(graph_type& gf, int k, int time, cascade_type& cascade, double e
 	table.clear();
 	tableWithTime.clear();
 	targets.clear();
+	_OpenRRCache(gf, time, time, false);
 
 	double sum_weight = 0.0;
 	for (int i = 0; i < time; i++)
@@ -1673,8 +1939,8 @@ void IMM::Build(graph_type& gf, int k, int time, cascade_type& cascade, double e
 		vector<int> seeds;
 		vector< pair< int, int > > seedsWithTime;
 		vector<double> est_spread;
-		LARGE_INT64 nNewSamples = LARGE_INT64(theta - tableWithTime.size() + 1);
-		if (tableWithTime.size() < theta) {
+		LARGE_INT64 nNewSamples = LARGE_INT64(theta - _SampleCountWithTime() + 1);
+		if (_SampleCountWithTime() < theta) {
 			// generate samples
 			_AddRRSimulation1(nNewSamples, cascade, tableWithTime, targets, time);
 			_RebuildRRIndicesWithTime();
@@ -1748,6 +2014,7 @@ void IMM::Build(graph_type& gf, int k, int time, cascade_type& cascade, double e
 		stept.SetTimeEvent("step_end");
 		steptimers.push_back(stept);
 	}
+	rrCache.Close();
 	pctimer.SetTimeEvent("end");
 
 	// Write results to file:
@@ -13,6 +13,9 @@
 #include "graph.h"
 #include "common.h"
 #include "reverse_general_cascade.h"
+#include "rr_pool.h"
+#include "rr_index.h"
+#include "rr_cache.h"
 #include "algo_base.h"
 #include "general_cascade.h"
 
@@ -26,37 +29,64 @@ public:
 	typedef ReverseGCascade cascade_type;
 	
 
-	RRInflBase() : m(0),
-			isConcurrent(false) {
+	RRInflBase() : isConcurrent(false), isBatchSampling(false), isCompressedRR(false),
+			m(0), sampleRound(0) {
 	}
 
 	// for concurrent optimization: using omp
 	bool isConcurrent; // turn on to use openmp
+	// sample RR sets in bit-parallel batches (ReverseGCascadeT::ReversePropagateBatch)
+	bool isBatchSampling;
+	// store RR sets packed (see RRPool), trades decoding time for memory
+	bool isCompressedRR;
+	// directory of the RR sample cache (see RRCache), empty to sample every run from scratch
+	std::string rrCacheDir;
+
+	/// Estimated spread n * (covered RR sets) / (all RR sets) of every seed set in seedSets,
+	/// on the RR sets of the last Build. The sets are scored in parallel if isConcurrent
+	std::vector<double> EstimateSpreads(const std::vector< std::vector<int> >& seedSets);
 
 protected:
 	int m;
+	/// counter of sampling calls, used to key the RNG streams of each call
+	int sampleRound;
 	
-	std::vector< RRVec > table;  //set of RR-set 
+	RRPool table;  //set of RR-set 
 	
 	std::vector<int> targets;
 	// degree of hyper-edges v, where e(u, v) in the hyper graph
 	// source id --> degrees
 	std::vector<int> degrees;  // c[v]
+	std::vector<int> baseDegrees; // c[v] of all indexed sets, before the greedy deducts
 
-	std::vector< std::vector<int> > degreeRRIndices; //RR[v]
+	RRIndex degreeRRIndices; //RR[v]
 	std::set<int> sourceSet; // all the source node ids
 
 	void InitializeConcurrent();
+
+	/// samples of the running Build, reused across runs (see RRCache)
+	RRCache rrCache;
+	/// Open the cache of the samples Build draws: timeSlices is 0 for plain RR sets
+	void _OpenRRCache(graph_type& gf, int timeSlices, int setsPerSample, bool labelled);
 	
 	void _AddRRSimulation(size_t num_iter, 
 		cascade_type& cascade, 
-		std::vector< RRVec >& refTable, 
+		RRPool& refTable, 
 		std::vector<int>& refTargets);
 	void _AddRRSimulation(size_t num_iter,
 		cascade_type& cascade, 
-		std::vector< RRVec >& refTable,
+		RRPool& refTable,
 		std::vector<int>& refTargets,
 		std::vector<int>& refEdgeVisited);
+	/// Samples the num_iter RR sets of one block from its stream
+	void _AddRRBlock(size_t num_iter,
+		cascade_type& cascade,
+		MIRandom& random,
+		RRPool& refTable,
+		std::vector<int>& refTargets,
+		std::vector<int>& refEdgeVisited,
+		TraversalScratch& scratch,
+		BatchTraversalScratch& batchScratch);
 
 
 	/*void RRInflBase::_AddRRSimulation(size_t num_iter,
@@ -158,10 +188,22 @@ public:
 		std::vector<double>& outEstSpread);
 	void _AddRRSimulation1(size_t num_iter,
 		cascade_type& cascade,
-		std::vector< std::vector< RRVec > >& refTable,
+		RRPool& refTable,
 		std::vector<int>& refTargets,
 		int k);
-
+	/// sample items [firstItem, firstItem+count) of the (target, slice) grid, item i*k+T is slice T of targets[i]
+	void _AddRRBlockWithTime(size_t firstItem,
+		size_t count,
+		cascade_type& cascade,
+		MIRandom& random,
+		RRPool& refTable,
+		const int* targets,
+		int k,
+		TraversalScratch& scratch,
+		BatchTraversalScratch& batchScratch);
+
+	/// number of targets sampled into tableWithTime
+	size_t _SampleCountWithTime() const { return timeSlices > 0 ? tableWithTime.size() / timeSlices : 0; }
 	void _RebuildRRIndicesWithTime();
 	void _RebuildRRIndicesWithReuse();
 	double _RunGreedyTest(int seed_size,
@@ -180,6 +222,12 @@ public:
 		std::vector< std::pair< int, int > >& outSeeds,
 		std::vector<double>& outEstSpread);
 	double Weight_iter(int weight_mode, int time);
+	/// Estimated spread of every (node, time) schedule on the samples of the last Build,
+	/// as _RunGreedy1 counts it: a sample is worth the weight of the earliest slice a seed covers it in.
+	/// The schedules are scored in parallel if isConcurrent
+	std::vector<double> EstimateSchedules(const std::vector< std::vector< std::pair<int, int> > >& schedules);
+	/// PRM ratio of an estimated spread, as Build reports it
+	double PRMRatio(double spread) const { return (spread + 1.0) * (1.0 + kb_0 / kp_0) - 1.0; }
 	void _SetResults1(const std::vector<std::pair<int, int>>& seeds, const std::vector<double>& cumu_spread);
 	virtual void WriteToFileWithTime(const std::string& filename, IGraph& gf);
 
@@ -200,8 +248,10 @@ protected:
 	std::vector<std::pair<int, int>> listWithTime;
 
 	std::vector< std::vector<double> > degreesWithTime; //c_t[v]
-	std::vector< std::vector< RRVec > > tableWithTime; // set of RR-set with label
-	std::vector< std::vector< std::vector<int> > > degreeRRIndicesWithTime; //RR_t[v]
+	std::vector< std::vector<double> > baseDegreesWithTime; // c_t[v] of all indexed sets, before the greedy deducts
+	RRPool tableWithTime; // k RR-sets per sample, one for each time slice
+	int timeSlices = 0; // k of the samples in tableWithTime
+	std::vector<RRIndex> degreeRRIndicesWithTime; //RR_t[v]
 	std::set<std::pair<int, int>> sourceSetWithTime;
 	std::vector<int> RR_number;
 
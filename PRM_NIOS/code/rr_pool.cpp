@@ -0,0 +1,65 @@
+#include <vector>
+#include "rr_pool.h"
+
+using namespace std;
+
+
+static inline size_t VarintSize(uint32_t v)
+{
+	size_t len = 1;
+	while (v >= 0x80) {
+		v >>= 7;
+		++len;
+	}
+	return len;
+}
+
+static inline void WriteVarint(vector<uint8_t>& out, uint32_t v)
+{
+	while (v >= 0x80) {
+		out.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((uint8_t)v);
+}
+
+void RRPool::AppendPacked(int* ids, size_t count)
+{
+	sort(ids, ids + count);
+
+	int encoding = RRSpan::DELTA_VARINT;
+	size_t bitmapBytes = 0;
+	if (count > 0) {
+		// choose the shorter one of the gaps and the bitmap
+		size_t varintBytes = VarintSize((uint32_t)ids[0]);
+		for (size_t i = 1; i < count; ++i) {
+			varintBytes += VarintSize((uint32_t)(ids[i] - ids[i - 1]));
+		}
+		bitmapBytes = (size_t)(ids[count - 1] - ids[0]) / 8 + 1;
+		if (bitmapBytes < varintBytes) {
+			encoding = RRSpan::BITMAP;
+		}
+	}
+
+	WriteVarint(packed, (uint32_t)(count << 2) | (uint32_t)encoding);
+	if (count > 0) {
+		if (encoding == RRSpan::BITMAP) {
+			int low = ids[0];
+			WriteVarint(packed, (uint32_t)low);
+			size_t start = packed.size();
+			packed.resize(start + bitmapBytes, 0);
+			for (size_t i = 0; i < count; ++i) {
+				int bit = ids[i] - low;
+				packed[start + bit / 8] |= (uint8_t)(1u << (bit % 8));
+			}
+		}
+		else {
+			WriteVarint(packed, (uint32_t)ids[0]);
+			for (size_t i = 1; i < count; ++i) {
+				WriteVarint(packed, (uint32_t)(ids[i] - ids[i - 1]));
+			}
+		}
+	}
+	offsets.push_back(packed.size());
+	nodeCount += count;
+}
@@ -1,12 +1,33 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include "simulate.h"
 
 
+namespace {
+	/// z such that a standard normal variable is within +-z with probability confidence
+	double NormalQuantile(double confidence)
+	{
+		// P(|Z| > z) = erfc(z / sqrt(2)) is decreasing in z, bisect it
+		double lo = 0.0, hi = 40.0;
+		for (int i = 0; i < 100; i++) {
+			double mid = (lo + hi) / 2;
+			if (std::erfc(mid / std::sqrt(2.0)) > 1.0 - confidence) lo = mid;
+			else hi = mid;
+		}
+		return (lo + hi) / 2;
+	}
+}
+
+
 
 Simu::Simu() 
 {
 	file = "";
 	simuSize = 0;
 	simuIterNum = NUM_ITER;
+	epsilon = 0.0;
+	confidence = 0.95;
 }
 
 Simu::Simu(std::vector<int>& seeds, 
@@ -18,6 +39,8 @@ Simu::Simu(std::vector<int>& seeds,
 	this->seeds = seeds;
 	this->simuSize = ((int)seeds.size() < simulateSize) ? (int)seeds.size() : simulateSize;
 	this->simuIterNum = simuIterNum;
+	epsilon = 0.0;
+	confidence = 0.95;
 }
 
 Simu::Simu(int* seeds, 
@@ -31,6 +54,8 @@ Simu::Simu(int* seeds,
 	}
 	this->simuSize = simulateSize;
 	this->simuIterNum = simuIterNum;
+	epsilon = 0.0;
+	confidence = 0.95;
 }
 
 
@@ -45,6 +70,8 @@ Simu::Simu(int(*GetNode)(int i),
 	}
 	this->simuSize = simulateSize;
 	this->simuIterNum = simuIterNum;
+	epsilon = 0.0;
+	confidence = 0.95;
 }
 
 double Simu::toSimulate(ICascade& cascade)
@@ -74,6 +101,104 @@ double Simu::toSimulate(ICascade& cascade)
 	return spread;
 }
 
+double Simu::toSimulatePrefixes(GeneralCascade& cascade)
+{
+	std::ofstream out;
+	if (isWriteFile()) {
+		out.open(file.c_str());
+	}
+
+	std::vector<double> spreads;
+	if (simuSize > 0) {
+		spreads = cascade.RunPrefixes(simuIterNum, simuSize, seeds.data());
+	}
+	double spread = 0.0;
+	for (int t = 0; t < simuSize; t++)
+	{
+		spread = spreads[t];
+
+		printf("%02d \t %10g\n", t + 1, spread);
+		if (isWriteFile()) {
+			out << (t + 1) << "\t" << spread << std::endl;
+		}
+	}
+
+	if (isWriteFile()) {
+		out.close();
+	}
+	return spread;
+}
+
+double Simu::toSimulateAdaptive(GeneralCascade& cascade, bool isAllPrefixes)
+{
+	if (simuSize <= 0) return 0.0;
+
+	std::ofstream out;
+	if (isWriteFile()) {
+		out.open(file.c_str());
+	}
+
+	const int blockSize = GeneralCascade::RUN_BLOCK_SIZE;
+	int maxBlocks = std::max(1, (simuIterNum + blockSize - 1) / blockSize);
+	double z = NormalQuantile(confidence);
+	int firstReported = isAllPrefixes ? 0 : simuSize - 1;
+
+	// running mean and variance (Welford) of the block means of every prefix. The iterations of a block
+	// are independent, so a block mean is one sample of the spread, with the variance of an iteration
+	// over RUN_BLOCK_SIZE, and the blocks of a run are independent of the thread count
+	std::vector<double> mean(simuSize, 0.0);
+	std::vector<double> m2(simuSize, 0.0);
+	// the interval is unknown until there are 2 block means
+	std::vector<double> halfWidth(simuSize, std::numeric_limits<double>::infinity());
+	std::vector<long long> sums;
+	unsigned long long runKey = cascade.NewRunKey();
+	int blocks = 0;
+	bool isPrecise = false;
+	while (blocks < maxBlocks) {
+		int count = std::min(ADAPTIVE_ROUND_BLOCKS, maxBlocks - blocks);
+		cascade.RunPrefixBlocks(runKey, blocks, count, simuSize, seeds.data(), sums);
+		for (int b = 0; b < count; b++) {
+			blocks++;
+			for (int t = 0; t < simuSize; t++) {
+				double x = (double)sums[(size_t)b * simuSize + t] / blockSize;
+				double delta = x - mean[t];
+				mean[t] += delta / blocks;
+				m2[t] += delta * (x - mean[t]);
+			}
+		}
+
+		// stop once every reported spread is known to within epsilon of itself
+		if (blocks < 2) continue;
+		isPrecise = true;
+		for (int t = firstReported; t < simuSize; t++) {
+			halfWidth[t] = z * std::sqrt(m2[t] / (blocks - 1) / blocks);
+			if (halfWidth[t] > epsilon * mean[t]) isPrecise = false;
+		}
+		if (isPrecise) break;
+	}
+
+	for (int t = firstReported; t < simuSize; t++)
+	{
+		if (isAllPrefixes) {
+			printf("%02d \t %10g \t +- %g\n", t + 1, mean[t], halfWidth[t]);
+		}
+		else {
+			printf("seed set size = %d, spread = %10g +- %g\n", t + 1, mean[t], halfWidth[t]);
+		}
+		if (isWriteFile()) {
+			out << (t + 1) << "\t" << mean[t] << "\t" << halfWidth[t] << std::endl;
+		}
+	}
+	printf("%d iterations, %g%% confidence intervals", blocks * blockSize, confidence * 100);
+	if (!isPrecise) printf(", not converged to +-%g of the spread", epsilon);
+	printf("\n");
+
+	if (isWriteFile()) {
+		out.close();
+	}
+	return mean[simuSize - 1];
+}
+
 
 double Simu::toSimulateOnce(ICascade& cacade)
 {
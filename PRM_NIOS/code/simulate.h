@@ -19,6 +19,14 @@ public:
 	std::vector<int> seeds;
 	int simuSize;
 	int simuIterNum;
+	/// toSimulateAdaptive stops once the half width of the confidence interval of the spread at level
+	/// confidence is at most epsilon times the spread, or after simuIterNum iterations
+	double epsilon;
+	double confidence;
+
+	/// the blocks of GeneralCascade::RUN_BLOCK_SIZE iterations are simulated ADAPTIVE_ROUND_BLOCKS at a time,
+	/// the precision is checked once there are 2 blocks
+	static const int ADAPTIVE_ROUND_BLOCKS = 8;
 
 	Simu();
 	Simu(std::vector<int>& seeds, 
@@ -36,6 +44,11 @@ public:
 
 public:
 	double toSimulate(ICascade& cascade);
+	/* as toSimulate, with all the prefix sizes from one traversal of every world (see GeneralCascadeT::RunPrefixes) */
+	double toSimulatePrefixes(GeneralCascade& cascade);
+	/* as toSimulatePrefixes (or toSimulateOnceFile, for the whole set only) in rounds of parallel blocks until the spreads
+	   are precise to epsilon, see above. The spreads are reported with the half widths of their confidence intervals */
+	double toSimulateAdaptive(GeneralCascade& cascade, bool isAllPrefixes);
 	double toSimulateOnce(ICascade& cacade);
 	double toSimulateOnceFile(ICascade& cacade); /* additionally write spread result into file */
 	std::vector<bool> toSimulatePRM2(GeneralCascade& cascade);
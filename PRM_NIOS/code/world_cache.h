@@ -0,0 +1,64 @@
+#ifndef world_cache_h__
+#define world_cache_h__
+
+#include <vector>
+#include <cstdint>
+#include "cascade.h"
+#include "mi_scratch.h"
+
+
+/// Cache of sampled live-edge worlds of the IC model: in a world, edge e is live with the probability of e.th1.
+/// The worlds are kept in groups of 64, one bit per world, as a word for every edge of the CSR edge array.
+/// A spread is then a bit-parallel reachability over the groups without any random draw,
+/// so the worlds are sampled once and all seed sets are evaluated on the same ones (common random numbers).
+class WorldCache
+	: public ICascade
+{
+public:
+	/// Number of worlds in one group, one bit of a word each
+	static const int GROUP_SIZE = 64;
+
+	/// turn on to spread the groups over the omp threads
+	bool isConcurrent;
+	/// key of the streams of the worlds: caches of one run that should hold different worlds need different keys
+	unsigned long long streamKey;
+
+protected:
+	Graph* gf;
+	int worldCount;
+	/// live[g][e]: the worlds of group g in which edge e is live
+	std::vector< std::vector<uint64_t> > live;
+
+	/// mask of the worlds of group g among the first count ones
+	uint64_t _Worlds(int g, int count) const
+	{
+		count -= g * GROUP_SIZE;
+		return (count >= GROUP_SIZE) ? ~0ULL : (1ULL << count) - 1;
+	}
+	uint64_t _Worlds(int g) const { return _Worlds(g, worldCount); }
+
+	long long _Activate(int g, uint64_t worlds, int size, const int set[], BatchTraversalScratch& scratch) const;
+
+public:
+	WorldCache() : isConcurrent(true), streamKey(0), gf(NULL), worldCount(0) {}
+
+	/// Sample worldCount worlds of gf, group g from the stream StreamSeed(StreamSeed(WORLD_STREAMS, streamKey), g)
+	void Build(Graph& gf, int worldCount);
+
+	int WorldCount() const { return worldCount; }
+	int GroupCount() const { return (int)live.size(); }
+
+	/// Activate the seeds set[0 ... size) in the worlds of group g. On return, scratch.reached[v] holds the
+	/// worlds of the group in which v is active, for the nodes v in scratch.touched. Returns the activations
+	long long Activate(int g, int size, const int set[], BatchTraversalScratch& scratch) const
+	{
+		return _Activate(g, _Worlds(g), size, set, scratch);
+	}
+
+	/// Average number of activated nodes over the first num_iter cached worlds, which stand for
+	/// num_iter simulations. All the worlds are used if num_iter is larger or not positive
+	virtual double Run(int num_iter, int size, int set[]);
+};
+
+
+#endif // world_cache_h__
@@ -67,6 +67,9 @@ public:
 	std::vector<int> index;
 	std::vector<TEdge> edges;
 	EdgeFormType edgeForm;
+	/// node -> 1 / log(1 - p) if all its edges share the same w2 probability p,
+	/// so the activated ones can be reached by geometric skips; 0 otherwise
+	std::vector<double> invLogFailW2;
 
 protected:
 	NodeMap nodeMap;
@@ -97,7 +100,7 @@ public:
 	}
 
 public:
-	GraphT() : n(0), m(0), degree(), index(), edges(), nodeMap(), edgeForm(EdgeForm::NORMAL_EDGE) {}
+	GraphT() : n(0), m(0), degree(), index(), edges(), nodeMap(), edgeForm(EdgeForm::NORMAL_EDGE), invLogFailW2() {}
 
 public:
 	/// Number of nodes graph
@@ -358,6 +361,32 @@ public:
 			if (g.index[i] < g.index[i - 1])
 				g.index[i] = g.index[i - 1];
 
+		// precompute the integer acceptance thresholds of both directions,
+		// so the samplers flip a coin with one raw random word
+		ProbTransfom trans(g.edgeForm);
+		for (int i = 0; i < g.m; i++) {
+			g.edges[i].th1 = MIRandom::ProbThreshold(trans.Prob(g.edges[i].w1));
+			g.edges[i].th2 = MIRandom::ProbThreshold(trans.Prob(g.edges[i].w2));
+		}
+
+		// nodes whose edges share one w2 (e.g. weighted cascade) can skip to the activated edges,
+		// which pays off once the expected skip is longer than a few coin flips
+		const int GEOMETRIC_SKIP_MIN_DEGREE = 8;
+		g.invLogFailW2.assign(g.n, 0.0);
+		for (int u = 0; u < g.n; u++) {
+			int k = g.GetNeighborCount(u);
+			if (k < GEOMETRIC_SKIP_MIN_DEGREE) continue;
+			double p = trans.Prob(g.GetEdge(u, 0).w2);
+			if (p <= 0.0 || p >= 1.0) continue;
+			bool isUniform = true;
+			for (int i = 1; i < k && isUniform; i++) {
+				isUniform = (trans.Prob(g.GetEdge(u, i).w2) == p);
+			}
+			if (isUniform) {
+				g.invLogFailW2[u] = 1.0 / log(1.0 - p);
+			}
+		}
+
 		return g;
 	}
 
@@ -10,6 +10,7 @@
 #include <memory>
 #include <string>
 #include <cassert>
+#include <cstdint>
 #include <type_traits>
 #include "common.h"
 #include "mi_random.h"
@@ -57,8 +58,10 @@ public:
 	double w1;
 	/// Probability v->u
 	double w2;
+	/// Acceptance thresholds of w1 and w2 for MIRandom::RandAccept (set by GraphFactoryT::Build)
+	uint32_t th1, th2;
 
-	Edge(double w1 = 0.0, double w2 = 0.0, int c = 1) : EdgeBase(), c(c), w1(w1), w2(w2) {}
+	Edge(double w1 = 0.0, double w2 = 0.0, int c = 1) : EdgeBase(), c(c), w1(w1), w2(w2), th1(0), th2(0) {}
 
 public:
 	void Serialize(std::ostream& sout, IGraph& gf);
@@ -123,7 +126,7 @@ public:
 			logNegf = logNegConv;
 		}
 		else if (edgeForm == EdgeForm::LOG_NEG_EDGE) {
-			f = negExpf;
+			f = negExpConv;
 			logNegf = identicalConv;
 		}
 		else {
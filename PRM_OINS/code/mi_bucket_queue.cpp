@@ -0,0 +1 @@
+#include "mi_bucket_queue.h"
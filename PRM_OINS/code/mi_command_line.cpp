@@ -11,6 +11,12 @@ std::string MICommandLine::Help()
 		MI_SOFTWARE_META "\n"
 		"\n"
 		"-h: print the help \n"
+		"--seed <s>: fix the random seed of the run, can be appended to any switch \n"
+		"--batch: sample RR sets, and simulate the worlds of -t, in bit-parallel batches of 64, can be appended to any switch \n"
+		"--compress: store RR sets delta/varint or bitmap packed to save memory, can be appended to any switch \n"
+		"--rr-cache <dir>: keep the RR samples of -rr5/-rr6 in <dir> and reuse them in later runs with the same graph, time and --seed \n"
+		"--worlds <R>: -g and -r evaluate seed sets on R live-edge worlds sampled once, instead of fresh simulations: N simulations use the first min(N, R) worlds \n"
+		"--adaptive <epsilon> <confidence>: -t stops once the <confidence> interval of every spread is within +-<epsilon> times the spread, num_iter (rounded up to whole blocks of 64) is the cap. <epsilon> > 0, 0 < <confidence> < 1 \n"
 		"-t seeds_file <num_iter=10000> <seed_set_size = 50> <output_file=GC_spread.txt> <nthreads=1> <mode=0>: test influence spread with seeds \n"
 		"-rr5 <eps=0.1> <ell=1.0>	<k = 50> <mode = 1> <round = 10> <dp0 = 400> <dn0 = 10> <a = 10> (PRM-IMM OINS) \n"
 		"\n"
@@ -45,10 +51,47 @@ int MICommandLine::Main(int argc, char * argv[])
 	return Main(argc, argVec);
 }
 
+int MICommandLine::StripOptions(int argc, std::vector<std::string>& argv)
+{
+	std::vector<std::string> rest;
+	for (int i = 0; i < argc; i++) {
+		const std::string& option = argv[i];
+		// number of values that follow the option
+		int count = -1;
+		if (option == "--batch" || option == "--compress") count = 0;
+		else if (option == "--seed" || option == "--rr-cache" || option == "--worlds") count = 1;
+		else if (option == "--adaptive") count = 2;
+		if (i == 0 || count < 0 || i + count >= argc) {
+			rest.push_back(option);
+			continue;
+		}
+
+		if (option == "--batch") isBatchSampling = true;
+		else if (option == "--compress") isCompressedRR = true;
+		else if (option == "--seed") MIRandom::SetRunSeed(std::stoull(argv[i + 1]));
+		else if (option == "--rr-cache") rrCacheDir = argv[i + 1];
+		else if (option == "--worlds") worldCount = std::stoi(argv[i + 1]);
+		else if (option == "--adaptive") {
+			isAdaptive = true;
+			adaptiveEpsilon = std::stod(argv[i + 1]);
+			adaptiveConfidence = std::stod(argv[i + 2]);
+		}
+		i += count;
+	}
+	argv.swap(rest);
+	return (int)argv.size();
+}
+
 int MICommandLine::Main(int argc, std::vector<std::string>& argv)
 {
 	srand((unsigned)time(NULL));
-	
+
+	argc = StripOptions(argc, argv);
+	if (isAdaptive && !(adaptiveEpsilon > 0 && adaptiveConfidence > 0 && adaptiveConfidence < 1)) {
+		std::cout << "--adaptive: <epsilon> must be > 0 and <confidence> within (0, 1)" << std::endl;
+		return 1;
+	}
+
 	if (argc <= 1) {
 		std::cout << Help() << std::endl;
 		return 0;
@@ -64,6 +107,9 @@ int MICommandLine::Main(int argc, std::vector<std::string>& argv)
 		return 0;
 	}
 
+	// fix the run seed before any sampling starts, and print it so that the run can be repeated
+	std::cout << "seed = " << MIRandom::GetRunSeed() << std::endl;
+
 	// the following contains switches for algorithms
 	system("mkdir tmp");
 	system("cd tmp");
@@ -150,6 +196,7 @@ void MICommandLine::TestSeeds(int argc, std::vector<std::string>& argv)
 	}
 
 	cascade.nthreads = (nthreads <= 1) ? 1 : nthreads;
+	cascade.isBatchRun = isBatchSampling;
 
 	SeedIO io;
 	std::vector<int> seeds = io.Read(seeds_file, gf);
@@ -158,8 +205,14 @@ void MICommandLine::TestSeeds(int argc, std::vector<std::string>& argv)
 	EventTimer timer;
 	timer.SetTimeEvent("start");
 
-	if (mode == 0) {
-		Simu(seeds, outfile, size, num_iter).toSimulate(cascade);
+	if (isAdaptive) {
+		Simu simu(seeds, outfile, size, num_iter);
+		simu.epsilon = adaptiveEpsilon;
+		simu.confidence = adaptiveConfidence;
+		simu.toSimulateAdaptive(cascade, mode == 0);
+	}
+	else if (mode == 0) {
+		Simu(seeds, outfile, size, num_iter).toSimulatePrefixes(cascade);
 	}
 	else {
 		Simu(seeds, outfile, size, num_iter).toSimulateOnceFile(cascade);
@@ -179,8 +232,11 @@ void MICommandLine::BuildRanking(int argc, std::vector<std::string>& argv)
 	Graph gf = fact.Build(std::cin);
 	GeneralCascade cascade;
 	cascade.Build(gf);
+	WorldCache worlds;
+	if (worldCount > 0) worlds.Build(gf, worldCount);
+	ICascade& evaluator = (worldCount > 0) ? (ICascade&)worlds : (ICascade&)cascade;
 	Greedy alg;
-	alg.BuildRanking(gf, 100, cascade);
+	alg.BuildRanking(gf, 100, evaluator);
 }
 
 
@@ -235,11 +291,14 @@ void MICommandLine::GreedyAlg(int argc, std::vector<std::string>& argv)
 	Graph gf = fact.Build(std::cin);
 	GeneralCascade cascade;
 	cascade.Build(gf);
+	WorldCache worlds;
+	if (worldCount > 0) worlds.Build(gf, worldCount);
+	ICascade& evaluator = (worldCount > 0) ? (ICascade&)worlds : (ICascade&)cascade;
 
 	EventTimer timer;
 	timer.SetTimeEvent("start");
 	Greedy alg;
-	alg.Build(gf, min(SET_SIZE, gf.GetN()), cascade);
+	alg.Build(gf, min(SET_SIZE, gf.GetN()), evaluator);
 	timer.SetTimeEvent("end");
 
 	FILE* timetmpfile;
@@ -394,6 +453,9 @@ void MICommandLine::RRAlg(int argc, std::vector<std::string>& argv)
 		cout << "#seeds = " << maxK << endl;
 		RRInfl infl;
 		infl.isConcurrent = isConcurrent;
+		infl.isBatchSampling = isBatchSampling;
+		infl.isCompressedRR = isCompressedRR;
+		infl.rrCacheDir = rrCacheDir;
 		infl.Build(gf, maxK, cascade, num_iter);
 		char rrinfl_simu_file[] = "GC_rr_infl.txt";
 		// toSimulate(rrinfl_simu_file, RRInfl::GetNode, GeneralCascade::Run);
@@ -407,6 +469,9 @@ void MICommandLine::RRAlg(int argc, std::vector<std::string>& argv)
 		cout << "ell = " << ell << endl;
 		TimPlus infl;
 		infl.isConcurrent = isConcurrent;
+		infl.isBatchSampling = isBatchSampling;
+		infl.isCompressedRR = isCompressedRR;
+		infl.rrCacheDir = rrCacheDir;
 		infl.Build(gf, maxK, cascade, eps, ell);
 		//char rrinfl_simu_file[] = "GC_rr_timplus_infl.txt";
 		// toSimulate(rrinfl_simu_file, TimPlus::GetNode, GeneralCascade::Run);
@@ -422,6 +487,9 @@ void MICommandLine::RRAlg(int argc, std::vector<std::string>& argv)
 		cout << "isConcurrent = " << isConcurrent << endl;
 		IMM infl;
 		infl.isConcurrent = isConcurrent;
+		infl.isBatchSampling = isBatchSampling;
+		infl.isCompressedRR = isCompressedRR;
+		infl.rrCacheDir = rrCacheDir;
 		infl.Build(gf, maxK, cascade, eps, ell, mode);
 		// char rrinfl_simu_file[] = "GC_rr_imm_infl.txt";
 		// toSimulate(rrinfl_simu_file, IMM::GetNode, GeneralCascade::Run);
@@ -444,6 +512,9 @@ void MICommandLine::RRAlg(int argc, std::vector<std::string>& argv)
 		infl.kb_0 = d_n;
 		infl.m_0 = a;
 		infl.isConcurrent = isConcurrent;
+		infl.isBatchSampling = isBatchSampling;
+		infl.isCompressedRR = isCompressedRR;
+		infl.rrCacheDir = rrCacheDir;
 		infl.Build(gf, maxK, round, cascade, eps, ell, mode);
 		// char rrinfl_simu_file[] = "GC_rr_imm_infl.txt";
 		// toSimulate(rrinfl_simu_file, IMM::GetNode, GeneralCascade::Run);
@@ -464,6 +535,9 @@ void MICommandLine::RRAlg(int argc, std::vector<std::string>& argv)
 		infl.kb_0 = d_n;
 		infl.m_0 = a;
 		infl.isConcurrent = isConcurrent;
+		infl.isBatchSampling = isBatchSampling;
+		infl.isCompressedRR = isCompressedRR;
+		infl.rrCacheDir = rrCacheDir;
 		infl._Build(gf, maxK, round, cascade, eps, ell, mode);
 		// char rrinfl_simu_file[] = "GC_rr_imm_infl.txt";
 		// toSimulate(rrinfl_simu_file, IMM::GetNode, GeneralCascade::Run);
@@ -19,6 +19,7 @@
 
 #include "event_timer.h"
 #include "simulate.h"
+#include "world_cache.h"
 
 
 #include "rr_infl.h"
@@ -31,8 +32,24 @@
 class MICommandLine
 {
 public:
+	/// set by --batch, forwarded to RRInflBase::isBatchSampling and GeneralCascade::isBatchRun
+	bool isBatchSampling = false;
+	/// set by --compress, forwarded to RRInflBase::isCompressedRR
+	bool isCompressedRR = false;
+	/// set by --rr-cache <dir>, forwarded to RRInflBase::rrCacheDir
+	std::string rrCacheDir;
+	/// set by --worlds <R>: -g and -r evaluate seed sets on R cached live-edge worlds (see WorldCache)
+	int worldCount = 0;
+	/// set by --adaptive <epsilon> <confidence>: -t simulates until the spreads are precise to epsilon (see Simu::epsilon)
+	bool isAdaptive = false;
+	double adaptiveEpsilon = 0.0;
+	double adaptiveConfidence = 0.95;
+
 	int Main(int argc, char* argv[]);
 	int Main(int argc, std::vector<std::string>& argv);
+	/// Apply the long options (--seed, --batch, ...) wherever they appear and strip them,
+	/// so that the positional parameters of the switches follow. Returns the new argc
+	int StripOptions(int argc, std::vector<std::string>& argv);
 	std::string Help();
 	void BuildRanking(int argc, std::vector<std::string>& argv);
 	void TestSeeds(int argc, std::vector<std::string>& argv);
@@ -0,0 +1 @@
+#include "mi_lazy_heap.h"
@@ -2,12 +2,63 @@
 #include <cmath>
 #include "mi_random.h"
 
+namespace {
+	bool isRunSeedFixed = false;
+	unsigned long long runSeed = 0;
+
+	/// splitmix64 finalizer, used to derive well separated stream seeds
+	unsigned long long MixSeed(unsigned long long x)
+	{
+		x += 0x9E3779B97F4A7C15ULL;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+		return x ^ (x >> 31);
+	}
+}
+
 MIRandom::MIRandom(void)
 {
 	device rd;
 	engine.seed(rd());
 }
 
+MIRandom::MIRandom(unsigned long long seed)
+{
+	Seed(seed);
+}
+
+void MIRandom::Seed(unsigned long long seed)
+{
+	std::seed_seq seq{ (unsigned int)(seed & 0xFFFFFFFFULL), (unsigned int)(seed >> 32) };
+	engine.seed(seq);
+}
+
+void MIRandom::SetRunSeed(unsigned long long seed)
+{
+	runSeed = seed;
+	isRunSeedFixed = true;
+}
+
+unsigned long long MIRandom::GetRunSeed()
+{
+	if (!isRunSeedFixed) {
+		device rd;
+		SetRunSeed(((unsigned long long)rd() << 32) | rd());
+	}
+	return runSeed;
+}
+
+unsigned long long MIRandom::StreamSeed(unsigned long long a, unsigned long long b /*= 0*/)
+{
+	return MixSeed(MixSeed(GetRunSeed() ^ MixSeed(a)) ^ b);
+}
+
+
+unsigned long long MIRandom::RandSeed()
+{
+	unsigned long long hi = (uint32_t)engine();
+	return (hi << 32) | (uint32_t)engine();
+}
 
 double MIRandom::RandUnit()
 {
@@ -29,6 +80,15 @@ bool MIRandom::RandBernoulli(double p)
 	return d(engine);
 }
 
+uint32_t MIRandom::ProbThreshold(double p)
+{
+	if (p <= 0.0) return 0;
+	if (p >= 1.0) return ALWAYS_ACCEPT;
+	// p * 2^32, the draw is accepted if it is below it
+	unsigned long long threshold = (unsigned long long)(p * 4294967296.0);
+	return (threshold >= ALWAYS_ACCEPT) ? ALWAYS_ACCEPT : (uint32_t)threshold;
+}
+
 double MIRandom::RandExp(double a)
 {
 	exponential_dist d(a);
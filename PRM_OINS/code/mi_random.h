@@ -2,7 +2,9 @@
 #define mi_random_h__
 
 #include <random>
+#include <cmath>
 #include <functional>
+#include <cstdint>
 
 /// A class to generate random values from multiple distributions
 class MIRandom
@@ -20,12 +22,50 @@ protected:
 	random_engine engine;
 
 public:
+	/// Stream tags, the first key of StreamSeed for the streams owned by objects (see CascadeT::streamKey,
+	/// WorldCache::streamKey). They lie far above the sampling rounds, which count from 0
+	static const unsigned long long CASCADE_STREAMS = 0xC000000000000000ULL;
+	static const unsigned long long WORLD_STREAMS = 0xD000000000000000ULL;
+
+	/// Seeded from random_device, so never reproducible: generators that should repeat under
+	/// a fixed run seed are constructed from a stream seed instead
 	MIRandom();
+	/// Construct with an explicit seed, e.g. one from StreamSeed()
+	explicit MIRandom(unsigned long long seed);
+
+	void Seed(unsigned long long seed);
+
+	/// Fix the seed of the whole run. Without it, a seed is drawn from random_device.
+	static void SetRunSeed(unsigned long long seed);
+	static unsigned long long GetRunSeed();
+	/// Seed of an independent stream keyed by (run seed, a, b).
+	/// Parallel samplers use it as StreamSeed(round, block), so results do not depend on threads.
+	static unsigned long long StreamSeed(unsigned long long a, unsigned long long b = 0);
+
+	/// 64 random bits, e.g. to key the streams of one parallel run with StreamSeed(key, block)
+	unsigned long long RandSeed();
 
 	// [a,b]
 	int RandInt(int a, int b);
 	double RandUnit(); 
 	bool RandBernoulli(double p);
+
+	/// Threshold that accepts every draw
+	static const uint32_t ALWAYS_ACCEPT = 0xFFFFFFFFu;
+	/// Convert probability p into a 32-bit acceptance threshold for RandAccept
+	static uint32_t ProbThreshold(double p);
+	/// Bernoulli trial with a threshold from ProbThreshold: one raw 32-bit draw and an integer compare
+	inline bool RandAccept(uint32_t threshold)
+	{
+		return (threshold == ALWAYS_ACCEPT) || ((uint32_t)engine() < threshold);
+	}
+	/// Number of failures before the next success of trials with probability p,
+	/// given invLogFail = 1 / log(1 - p), 0 < p < 1 (geometric distribution)
+	inline double RandSkip(double invLogFail)
+	{
+		double u = ((double)(uint32_t)engine() + 1.0) * (1.0 / 4294967296.0); // (0, 1]
+		return std::floor(std::log(u) * invLogFail);
+	}
 	double RandExp(double a);
 	double RandWeibull(double a, double b);
 };
@@ -0,0 +1 @@
+#include "mi_scratch.h"
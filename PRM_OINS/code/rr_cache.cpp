@@ -0,0 +1,383 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include "rr_cache.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#endif
+
+using namespace std;
+
+
+namespace {
+	const char RR_CACHE_MAGIC[8] = { 'R', 'R', 'C', 'A', 'C', 'H', 'E', '2' };
+
+	/// On-disk header, followed by the sample records
+	struct RRCacheHeader
+	{
+		char magic[8];
+		uint64_t graphHash;
+		uint64_t seed;
+		int32_t edgeForm;
+		int32_t timeSlices;
+		int32_t setsPerSample;
+		int32_t labelled;
+		uint64_t sampleCount;
+		int32_t nextRound;
+		int32_t batchSampling;
+	};
+
+	RRCache::Key HeaderKey(const RRCacheHeader& h)
+	{
+		RRCache::Key key;
+		key.graphHash = h.graphHash;
+		key.seed = h.seed;
+		key.edgeForm = h.edgeForm;
+		key.timeSlices = h.timeSlices;
+		key.setsPerSample = h.setsPerSample;
+		key.labelled = h.labelled;
+		key.batchSampling = h.batchSampling;
+		return key;
+	}
+
+	/// Read the header of path, false if there is none of this key
+	bool ReadHeader(const string& path, const RRCache::Key& key, RRCacheHeader& h)
+	{
+		ifstream fin(path.c_str(), ios::binary);
+		if (!fin.read((char*)&h, sizeof(h))) return false;
+		return memcmp(h.magic, RR_CACHE_MAGIC, sizeof(h.magic)) == 0 && HeaderKey(h) == key;
+	}
+
+	bool WriteHeader(const string& path, const RRCache::Key& key, uint64_t sampleCount, int nextRound, bool create)
+	{
+		RRCacheHeader h;
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, RR_CACHE_MAGIC, sizeof(h.magic));
+		h.graphHash = key.graphHash;
+		h.seed = key.seed;
+		h.edgeForm = key.edgeForm;
+		h.timeSlices = key.timeSlices;
+		h.setsPerSample = key.setsPerSample;
+		h.labelled = key.labelled;
+		h.batchSampling = key.batchSampling;
+		h.sampleCount = sampleCount;
+		h.nextRound = nextRound;
+
+		ios_base::openmode mode = ios::binary | ios::out | (create ? ios::trunc : ios::in);
+		fstream fout(path.c_str(), mode);
+		if (!fout) return false;
+		fout.seekp(0, ios::beg);
+		fout.write((const char*)&h, sizeof(h));
+		return (bool)fout;
+	}
+
+	/// Exclusive lock on the file path.lock while in scope, which runs on the cache file path
+	/// take before they change it. Locking the side file leaves the cache file open to writes
+	class FileLock
+	{
+	protected:
+#if defined(_WIN32)
+		HANDLE handle;
+#else
+		int fd;
+#endif
+
+	public:
+		explicit FileLock(const string& path)
+		{
+			string lockPath = path + ".lock";
+#if defined(_WIN32)
+			handle = CreateFileA(lockPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+				NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+			OVERLAPPED ov;
+			memset(&ov, 0, sizeof(ov));
+			if (handle != INVALID_HANDLE_VALUE && !LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov)) {
+				CloseHandle(handle);
+				handle = INVALID_HANDLE_VALUE;
+			}
+#else
+			fd = open(lockPath.c_str(), O_RDWR | O_CREAT, 0644);
+			if (fd >= 0 && flock(fd, LOCK_EX) != 0) {
+				close(fd);
+				fd = -1;
+			}
+#endif
+		}
+
+		~FileLock()
+		{
+#if defined(_WIN32)
+			if (handle != INVALID_HANDLE_VALUE) {
+				OVERLAPPED ov;
+				memset(&ov, 0, sizeof(ov));
+				UnlockFileEx(handle, 0, 1, 0, &ov);
+				CloseHandle(handle);
+			}
+#else
+			// closing the file releases the lock
+			if (fd >= 0) close(fd);
+#endif
+		}
+
+		bool IsLocked() const
+		{
+#if defined(_WIN32)
+			return handle != INVALID_HANDLE_VALUE;
+#else
+			return fd >= 0;
+#endif
+		}
+	};
+}
+
+
+RRCache::RRCache() : path(), key(), sampleCount(0), cursor(0), storedCount(0), storedSize(0), records(), data(NULL), dataSize(0),
+#if defined(_WIN32)
+	fileHandle(NULL), mapHandle(NULL),
+#else
+	fd(-1),
+#endif
+	isOpen(false)
+{
+}
+
+RRCache::~RRCache()
+{
+	Close();
+}
+
+int RRCache::Open(const std::string& dir, const Key& key)
+{
+	Close();
+	this->key = key;
+
+	uint64_t h = 14695981039346656037ULL;
+	HashBytes(h, &key.graphHash, sizeof(key.graphHash));
+	HashBytes(h, &key.edgeForm, sizeof(key.edgeForm));
+	HashBytes(h, &key.timeSlices, sizeof(key.timeSlices));
+	HashBytes(h, &key.seed, sizeof(key.seed));
+	HashBytes(h, &key.setsPerSample, sizeof(key.setsPerSample));
+	HashBytes(h, &key.labelled, sizeof(key.labelled));
+	HashBytes(h, &key.batchSampling, sizeof(key.batchSampling));
+	char name[64];
+	snprintf(name, sizeof(name), "rr_cache_%016llx.bin", (unsigned long long)h);
+	path = dir.empty() ? string(name) : dir + "/" + name;
+
+	// no other run may change the file while it is checked and repaired
+	FileLock lock(path);
+	if (!lock.IsLocked()) {
+		cerr << "RR cache: cannot lock " << path << ", caching is off" << endl;
+		return 0;
+	}
+
+	// reuse the file if it holds samples of this key, start a new one otherwise
+	RRCacheHeader header;
+	bool isValid = ReadHeader(path, key, header);
+	if (!isValid) {
+		header.sampleCount = 0;
+		header.nextRound = 0;
+		if (!WriteHeader(path, key, 0, 0, true)) {
+			cerr << "RR cache: cannot write " << path << ", caching is off" << endl;
+			return 0;
+		}
+	}
+
+	sampleCount = (size_t)header.sampleCount;
+	if (!Map()) {
+		cerr << "RR cache: cannot map " << path << ", caching is off" << endl;
+		Unmap();
+		return 0;
+	}
+
+	// index the records, a record cut short by an interrupted Put() ends the stream
+	records.clear();
+	records.reserve(sampleCount);
+	size_t pos = sizeof(RRCacheHeader);
+	for (size_t i = 0; i < sampleCount; ++i) {
+		size_t p = pos + sizeof(int32_t);
+		bool isComplete = p <= dataSize;
+		for (int s = 0; isComplete && s < key.setsPerSample; ++s) {
+			p += (key.labelled ? sizeof(int32_t) : 0) + sizeof(int32_t);
+			if (p > dataSize) {
+				isComplete = false;
+				break;
+			}
+			int32_t size;
+			memcpy(&size, data + p - sizeof(int32_t), sizeof(size));
+			p += (size_t)size * sizeof(int32_t);
+			isComplete = p <= dataSize;
+		}
+		if (!isComplete) break;
+		records.push_back(pos);
+		pos = p;
+	}
+	sampleCount = records.size();
+	storedCount = sampleCount;
+	storedSize = pos;
+	cursor = 0;
+	isOpen = true;
+	if (storedCount != (size_t)header.sampleCount || pos != dataSize) {
+		// drop the broken tail, new samples go right after the last complete record
+		Unmap();
+		isOpen = false;
+#if defined(_WIN32)
+		HANDLE hf = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hf != INVALID_HANDLE_VALUE) {
+			LARGE_INTEGER li;
+			li.QuadPart = (LONGLONG)pos;
+			SetFilePointerEx(hf, li, NULL, FILE_BEGIN);
+			SetEndOfFile(hf);
+			CloseHandle(hf);
+		}
+#else
+		if (truncate(path.c_str(), (off_t)pos) != 0) {
+			cerr << "RR cache: cannot repair " << path << ", caching is off" << endl;
+			return 0;
+		}
+#endif
+		WriteHeader(path, key, storedCount, header.nextRound, false);
+		if (!Map()) {
+			Unmap();
+			return 0;
+		}
+		isOpen = true;
+	}
+	return header.nextRound;
+}
+
+void RRCache::Close()
+{
+	Unmap();
+	records.clear();
+	sampleCount = cursor = storedCount = storedSize = 0;
+	isOpen = false;
+}
+
+bool RRCache::Map()
+{
+#if defined(_WIN32)
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		fileHandle = NULL;
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx((HANDLE)fileHandle, &size)) return false;
+	dataSize = (size_t)size.QuadPart;
+	mapHandle = CreateFileMappingA((HANDLE)fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapHandle == NULL) return false;
+	data = (const uint8_t*)MapViewOfFile((HANDLE)mapHandle, FILE_MAP_READ, 0, 0, 0);
+	return data != NULL;
+#else
+	fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0) return false;
+	dataSize = (size_t)st.st_size;
+	void* p = mmap(NULL, dataSize, PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) return false;
+	data = (const uint8_t*)p;
+	// records are read front to back
+	madvise(p, dataSize, MADV_SEQUENTIAL);
+	return true;
+#endif
+}
+
+void RRCache::Unmap()
+{
+#if defined(_WIN32)
+	if (data != NULL) UnmapViewOfFile(data);
+	if (mapHandle != NULL) CloseHandle((HANDLE)mapHandle);
+	if (fileHandle != NULL) CloseHandle((HANDLE)fileHandle);
+	mapHandle = fileHandle = NULL;
+#else
+	if (data != NULL) munmap((void*)data, dataSize);
+	if (fd >= 0) close(fd);
+	fd = -1;
+#endif
+	data = NULL;
+	dataSize = 0;
+}
+
+size_t RRCache::Take(size_t count, RRPool& refTable, std::vector<int>& refTargets)
+{
+	if (!isOpen || cursor >= sampleCount) return 0;
+	size_t last = min(sampleCount, cursor + count);
+	for (size_t i = cursor; i < last; ++i) {
+		const int32_t* p = (const int32_t*)(data + records[i]);
+		refTargets.push_back(*p++);
+		for (int s = 0; s < key.setsPerSample; ++s) {
+			if (key.labelled) {
+				int label = *p++;
+				int32_t size = *p++;
+				refTable.Append(p, p + size, label);
+				p += size;
+			}
+			else {
+				int32_t size = *p++;
+				refTable.Append(p, p + size);
+				p += size;
+			}
+		}
+	}
+	size_t taken = last - cursor;
+	cursor = last;
+	return taken;
+}
+
+void RRCache::Put(const RRPool& refTable, size_t firstSet, const std::vector<int>& refTargets, size_t firstTarget, int nextRound)
+{
+	if (!isOpen) return;
+	size_t count = refTargets.size() - firstTarget;
+	assert(refTable.size() - firstSet == count * key.setsPerSample);
+
+	FileLock lock(path);
+	RRCacheHeader header;
+	if (!lock.IsLocked() || !ReadHeader(path, key, header)) {
+		cerr << "RR cache: cannot write " << path << ", caching is off" << endl;
+		Close();
+		return;
+	}
+	if (header.sampleCount != storedCount) {
+		// the samples another run stored since may be from the same rounds, so that these would repeat them
+		cerr << "RR cache: " << path << " was extended by another run, the new samples are not stored" << endl;
+		Close();
+		return;
+	}
+	fstream fout(path.c_str(), ios::binary | ios::in | ios::out);
+	if (!fout) {
+		cerr << "RR cache: cannot write " << path << ", caching is off" << endl;
+		Close();
+		return;
+	}
+	// after the last complete record, over what an interrupted Put() may have left
+	fout.seekp((streamoff)storedSize, ios::beg);
+	vector<int32_t> buffer;
+	size_t set = firstSet;
+	for (size_t i = 0; i < count; ++i) {
+		buffer.clear();
+		buffer.push_back(refTargets[firstTarget + i]);
+		for (int s = 0; s < key.setsPerSample; ++s, ++set) {
+			if (key.labelled) buffer.push_back(refTable.Label(set));
+			RRSpan RR = refTable[set];
+			buffer.push_back((int32_t)RR.size());
+			for (int v : RR) buffer.push_back(v);
+		}
+		fout.write((const char*)buffer.data(), buffer.size() * sizeof(int32_t));
+		storedSize += buffer.size() * sizeof(int32_t);
+	}
+	fout.close();
+
+	// the header is written last, so an interrupted Put() leaves a readable file
+	storedCount += count;
+	WriteHeader(path, key, storedCount, nextRound, false);
+	// the fresh samples are already in use, so they count as taken
+	cursor = storedCount;
+}
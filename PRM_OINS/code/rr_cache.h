@@ -0,0 +1,127 @@
+#ifndef rr_cache_h__
+#define rr_cache_h__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "rr_pool.h"
+
+
+/// Persistent stream of RR samples, so that runs on the same graph, model, sampler and seed
+/// (e.g. sweeps over the PRM weights or k) do not sample again.
+///
+/// The file dir/rr_cache_<key>.bin holds a header and one record per sample:
+///   int32 target, then setsPerSample times { [int32 label], int32 size, int32 nodes[size] }.
+/// It is memory-mapped on Open. Samplers first Take() what the file holds, in order,
+/// and Put() what they sample beyond it, so the file only grows.
+/// The header also keeps the next unused sampling round: fresh samples of a later run
+/// draw from new streams (see MIRandom::StreamSeed) and never repeat cached ones.
+/// Runs on the same file take the lock file <file>.lock while they repair or extend it.
+/// Only one stream is kept: a run stops storing once another run has extended the file since it read it.
+class RRCache
+{
+public:
+	/// What the samples of a file depend on
+	struct Key
+	{
+		uint64_t graphHash;
+		int32_t edgeForm;
+		/// time slices of the model, 0 for plain RR sets
+		int32_t timeSlices;
+		uint64_t seed;
+		int32_t setsPerSample;
+		int32_t labelled;
+		/// 1 for the bit-parallel sampler of --batch, which draws other sets from the same seed
+		int32_t batchSampling;
+
+		Key() : graphHash(0), edgeForm(0), timeSlices(0), seed(0), setsPerSample(1), labelled(0), batchSampling(0) {}
+		bool operator == (const Key& other) const
+		{
+			return graphHash == other.graphHash && edgeForm == other.edgeForm && timeSlices == other.timeSlices
+				&& seed == other.seed && setsPerSample == other.setsPerSample && labelled == other.labelled
+				&& batchSampling == other.batchSampling;
+		}
+	};
+
+	/// Hash of the structure and the probabilities of a graph
+	template <class TGraph>
+	static uint64_t HashGraph(const TGraph& gf)
+	{
+		uint64_t h = 14695981039346656037ULL; // FNV-1a
+		HashBytes(h, &gf.n, sizeof(gf.n));
+		HashBytes(h, &gf.m, sizeof(gf.m));
+		for (size_t i = 0; i < gf.edges.size(); ++i) {
+			const typename TGraph::edge_type& e = gf.edges[i];
+			HashBytes(h, &e.u, sizeof(e.u));
+			HashBytes(h, &e.v, sizeof(e.v));
+			HashBytes(h, &e.w1, sizeof(e.w1));
+			HashBytes(h, &e.w2, sizeof(e.w2));
+		}
+		return h;
+	}
+
+protected:
+	std::string path;
+	Key key;
+	/// samples in the mapped file, and how many of them were handed out
+	size_t sampleCount;
+	size_t cursor;
+	/// samples in the file, including the ones Put() after it was mapped
+	size_t storedCount;
+	/// file size up to the end of the last of them
+	size_t storedSize;
+	/// byte offset of every mapped record
+	std::vector<size_t> records;
+	const uint8_t* data;
+	size_t dataSize;
+#if defined(_WIN32)
+	void* fileHandle;
+	void* mapHandle;
+#else
+	int fd;
+#endif
+	bool isOpen;
+
+	static void HashBytes(uint64_t& h, const void* p, size_t len)
+	{
+		const uint8_t* b = (const uint8_t*)p;
+		for (size_t i = 0; i < len; ++i) {
+			h = (h ^ b[i]) * 1099511628211ULL;
+		}
+	}
+
+	bool Map();
+	void Unmap();
+
+public:
+	RRCache();
+	~RRCache();
+
+	bool IsOpen() const { return isOpen; }
+	const std::string& Path() const { return path; }
+	/// Samples stored in the file when it was opened
+	size_t SampleCount() const { return sampleCount; }
+
+	/// Open (or create) the file of key in dir.
+	/// Returns the first sampling round not used by the samples of the file.
+	int Open(const std::string& dir, const Key& key);
+	void Close();
+
+	/// Whether the samples of the open file are of this kind
+	bool Matches(int timeSlices, int setsPerSample, bool labelled) const
+	{
+		return isOpen && key.timeSlices == timeSlices && key.setsPerSample == setsPerSample && key.labelled == (labelled ? 1 : 0);
+	}
+
+	/// Append the next (up to) count cached samples to refTable and refTargets.
+	/// Returns the number of samples taken.
+	size_t Take(size_t count, RRPool& refTable, std::vector<int>& refTargets);
+
+	/// Store the samples refTargets[firstTarget ...] with their sets refTable[firstSet ...]
+	/// at the end of the file, nextRound is the first sampling round they did not use
+	void Put(const RRPool& refTable, size_t firstSet, const std::vector<int>& refTargets, size_t firstTarget, int nextRound);
+};
+
+
+#endif // rr_cache_h__
@@ -0,0 +1,191 @@
+#include "rr_index.h"
+#include <climits>
+#include <cstdint>
+
+using namespace std;
+
+
+void RRIndex::_Reset(const RRPool& pool, int n, size_t first, size_t stride, int label)
+{
+	clear();
+	nodeCount = n;
+	source = &pool;
+	sourceGeneration = pool.Generation();
+	this->first = first;
+	this->stride = stride;
+	this->label = label;
+}
+
+std::shared_ptr<const RRIndex::Segment> RRIndex::_Merge(const Segment& a, const Segment& b, bool isConcurrent)
+{
+	std::shared_ptr<Segment> c = std::make_shared<Segment>();
+	c->isDense = a.isDense;
+	// walk the lists of both in node order, a dense a has them all. aPos and bPos are where their ids go in c
+	size_t na = a.ListCount(), nb = b.ListCount();
+	vector<size_t> aPos(na), bPos(nb);
+	c->offsets.push_back(0);
+	size_t i = 0, j = 0, total = 0;
+	while (i < na || j < nb) {
+		int va = (i < na) ? a.Node(i) : INT_MAX;
+		int vb = (j < nb) ? b.Node(j) : INT_MAX;
+		int v = min(va, vb);
+		if (!c->isDense) c->nodes.push_back(v);
+		if (va == v) { aPos[i] = total; total += a.ListSize(i++); }
+		if (vb == v) { bPos[j] = total; total += b.ListSize(j++); }
+		c->offsets.push_back(total);
+	}
+	c->ids.resize(total);
+
+#pragma omp parallel for schedule(static) if(isConcurrent)
+	for (int i = 0; i < (int)na; ++i) {
+		copy(a.ids.begin() + a.offsets[i], a.ids.begin() + a.offsets[i + 1], c->ids.begin() + aPos[i]);
+	}
+#pragma omp parallel for schedule(static) if(isConcurrent)
+	for (int j = 0; j < (int)nb; ++j) {
+		copy(b.ids.begin() + b.offsets[j], b.ids.begin() + b.offsets[j + 1], c->ids.begin() + bPos[j]);
+	}
+	return c;
+}
+
+void RRIndex::_Compact(bool isConcurrent)
+{
+	// the sizes at least halve from one segment to the next, so a lookup visits few segments
+	// and, beside the first segment, the offsets take no more room than the ids
+	while (segments.size() >= 2) {
+		const Segment& last = *segments.back();
+		const Segment& prev = *segments[segments.size() - 2];
+		if (last.ids.size() * 2 < prev.ids.size() && segments.size() < (size_t)MAX_SEGMENTS) break;
+		std::shared_ptr<const Segment> merged = _Merge(prev, last, isConcurrent);
+		segments.pop_back();
+		segments.back() = merged;
+	}
+}
+
+void RRIndex::_Append(const RRPool& pool, int n, size_t firstItem, size_t count,
+	const std::vector<int>* sets, bool isConcurrent)
+{
+	size_t lastItem = firstItem + count;
+	size_t entries = 0;
+	for (size_t j = firstItem; j < lastItem; ++j) {
+		entries += pool[(sets != NULL) ? (size_t)(*sets)[j] : first + j * stride].size();
+	}
+	if (entries == 0) return;
+
+	std::shared_ptr<Segment> next = std::make_shared<Segment>();
+	vector<size_t>& offsets = next->offsets;
+	vector<int>& ids = next->ids;
+	// only the first segment has a list for every node, so a round that adds few sets costs
+	// about their entries and not the node count
+	next->isDense = segments.empty();
+	if (!next->isDense && entries * 16 < (size_t)n) {
+		// few entries: sort (node, id) pairs. the items come in id order, and so do the ids of a node
+		vector<uint64_t> pairs;
+		pairs.reserve(entries);
+		for (size_t j = firstItem; j < lastItem; ++j) {
+			size_t set = (sets != NULL) ? (size_t)(*sets)[j] : first + j * stride;
+			uint64_t id = (uint64_t)((sets != NULL) ? (*sets)[j] : (int)j);
+			for (int v : pool[set]) pairs.push_back(((uint64_t)v << 32) | id);
+		}
+		std::sort(pairs.begin(), pairs.end());
+		ids.resize(entries);
+		offsets.push_back(0);
+		for (size_t e = 0; e < entries; ++e) {
+			int v = (int)(pairs[e] >> 32);
+			if (next->nodes.empty() || next->nodes.back() != v) {
+				if (!next->nodes.empty()) offsets.push_back(e);
+				next->nodes.push_back(v);
+			}
+			ids[e] = (int)(uint32_t)pairs[e];
+		}
+		offsets.push_back(entries);
+		segments.push_back(next);
+		return;
+	}
+
+	// the items are split into contiguous parts. a count pass gives the entries of every
+	// (part, node), a prefix sum turns them into write positions, and a scatter pass fills
+	// the lists. parts write in item order, so the ids of a node stay ascending.
+	// there are no more parts than entries per node, to keep the counts below the entries
+	int nParts = 1;
+#ifdef MI_USE_OMP
+	if (isConcurrent) nParts = (int)max((size_t)1, min((size_t)omp_get_max_threads(), min(count, entries / n)));
+#endif
+	vector< vector<int> > partCounts(nParts, vector<int>(n, 0));
+
+#pragma omp parallel for schedule(static) if(nParts > 1)
+	for (int p = 0; p < nParts; ++p) {
+		vector<int>& counts = partCounts[p];
+		size_t last = firstItem + count * (p + 1) / nParts;
+		for (size_t j = firstItem + count * p / nParts; j < last; ++j) {
+			size_t set = (sets != NULL) ? (size_t)(*sets)[j] : first + j * stride;
+			for (int v : pool[set]) counts[v]++;
+		}
+	}
+
+	offsets.assign(n + 1, 0);
+	for (int v = 0; v < n; ++v) {
+		size_t size = 0;
+		for (int p = 0; p < nParts; ++p) size += partCounts[p][v];
+		offsets[v + 1] = offsets[v] + size;
+	}
+	ids.resize(offsets[n]);
+	// counts become the position of the next entry of each part within the list of v
+#pragma omp parallel for schedule(static) if(nParts > 1)
+	for (int v = 0; v < n; ++v) {
+		int pos = 0;
+		for (int p = 0; p < nParts; ++p) {
+			int c = partCounts[p][v];
+			partCounts[p][v] = pos;
+			pos += c;
+		}
+	}
+
+#pragma omp parallel for schedule(static) if(nParts > 1)
+	for (int p = 0; p < nParts; ++p) {
+		vector<int>& cursors = partCounts[p];
+		size_t last = firstItem + count * (p + 1) / nParts;
+		for (size_t j = firstItem + count * p / nParts; j < last; ++j) {
+			size_t set = (sets != NULL) ? (size_t)(*sets)[j] : first + j * stride;
+			int id = (sets != NULL) ? (*sets)[j] : (int)j;
+			for (int v : pool[set]) ids[offsets[v] + cursors[v]++] = id;
+		}
+	}
+
+	if (!next->isDense) {
+		// keep the lists of the nodes in the new sets only
+		size_t kept = 0;
+		for (int v = 0; v < n; ++v) {
+			if (offsets[v + 1] == offsets[v]) continue;
+			next->nodes.push_back(v);
+			offsets[kept++] = offsets[v];
+		}
+		offsets[kept] = offsets[n];
+		offsets.resize(kept + 1);
+		offsets.shrink_to_fit();
+	}
+	segments.push_back(next);
+}
+
+void RRIndex::Build(const RRPool& pool, int n, size_t first, size_t stride, size_t count, bool isConcurrent)
+{
+	if (!_IsPrefixOf(pool, n, first, stride, -1) || count < itemCount) {
+		_Reset(pool, n, first, stride, -1);
+	}
+	_BeginBuild(isConcurrent);
+	_Append(pool, n, itemCount, count - itemCount, NULL, isConcurrent);
+	itemCount = count;
+}
+
+void RRIndex::BuildLabelled(const RRPool& pool, int n, int label, bool isConcurrent)
+{
+	if (!_IsPrefixOf(pool, n, 0, 1, label) || pool.size() < itemCount) {
+		_Reset(pool, n, 0, 1, label);
+	}
+	vector<int> sets;
+	for (size_t i = itemCount; i < pool.size(); ++i) {
+		if (pool.Label(i) == label) sets.push_back((int)i);
+	}
+	_BeginBuild(isConcurrent);
+	_Append(pool, n, 0, sets.size(), &sets, isConcurrent);
+	itemCount = pool.size();
+}
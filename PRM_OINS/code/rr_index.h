@@ -0,0 +1,206 @@
+#ifndef rr_index_h__
+#define rr_index_h__
+
+#include <vector>
+#include <cstddef>
+#include <memory>
+#include <algorithm>
+#include "rr_pool.h"
+
+
+/// Inverted index of the sets of an RRPool: for every node, the ids of the indexed sets holding it.
+/// Every Build adds one segment with the lists of the new sets (CSR), the old segments stay in place.
+/// The first segment has a list for every node, the later ones only for the nodes of their sets.
+/// Small segments are merged, so that there are at most MAX_SEGMENTS of them.
+/// The ids of a node are in ascending order across the segments.
+/// Copies of an index share its segments.
+class RRIndex
+{
+public:
+	static const int MAX_SEGMENTS = 8;
+
+	/// Read-only view of the ids of one node, in one run per segment
+	class List
+	{
+	protected:
+		struct Run
+		{
+			const int* first;
+			const int* last;
+			/// ids in this run and the runs before it
+			size_t end;
+		};
+		/// the non-empty runs
+		Run runs[MAX_SEGMENTS];
+		int runCount;
+
+	public:
+		class const_iterator
+		{
+		protected:
+			const Run* run;
+			const Run* lastRun;
+			const int* p;
+
+		public:
+			const_iterator(const Run* run, const Run* lastRun)
+				: run(run), lastRun(lastRun), p(run != lastRun ? run->first : NULL) {}
+
+			int operator*() const { return *p; }
+			const_iterator& operator++()
+			{
+				if (++p == run->last) {
+					++run;
+					p = (run != lastRun) ? run->first : NULL;
+				}
+				return *this;
+			}
+			bool operator!=(const const_iterator& other) const { return p != other.p; }
+			bool operator==(const const_iterator& other) const { return p == other.p; }
+		};
+
+		List() : runCount(0) {}
+
+		void AddRun(const int* first, const int* last)
+		{
+			if (first == last) return;
+			Run r = { first, last, size() + (size_t)(last - first) };
+			runs[runCount++] = r;
+		}
+
+		const_iterator begin() const { return const_iterator(runs, runs + runCount); }
+		const_iterator end() const { return const_iterator(runs + runCount, runs + runCount); }
+		size_t size() const { return (runCount == 0) ? 0 : runs[runCount - 1].end; }
+		bool empty() const { return runCount == 0; }
+		/// the run of i is found by a binary search over the runs
+		int operator[](size_t i) const
+		{
+			int r = 0;
+			if (runCount > 1) {
+				r = (int)(std::upper_bound(runs, runs + runCount, i,
+					[](size_t i, const Run& run) { return i < run.end; }) - runs);
+			}
+			size_t start = (r > 0) ? runs[r - 1].end : 0;
+			return runs[r].first[i - start];
+		}
+	};
+
+protected:
+	struct Segment
+	{
+		/// the i-th list holds the ids of node i if isDense, and of node nodes[i] (ascending) otherwise
+		bool isDense;
+		std::vector<int> nodes;
+		/// ids of the i-th list are ids[offsets[i] ... offsets[i+1])
+		std::vector<size_t> offsets;
+		std::vector<int> ids;
+
+		Segment() : isDense(false) {}
+
+		size_t ListCount() const { return offsets.size() - 1; }
+		int Node(size_t i) const { return isDense ? (int)i : nodes[i]; }
+		size_t ListSize(size_t i) const { return offsets[i + 1] - offsets[i]; }
+
+		void AddTo(List& list, int v) const
+		{
+			size_t i = (size_t)v;
+			if (!isDense) {
+				std::vector<int>::const_iterator it = std::lower_bound(nodes.begin(), nodes.end(), v);
+				if (it == nodes.end() || *it != v) return;
+				i = it - nodes.begin();
+			}
+			list.AddRun(ids.data() + offsets[i], ids.data() + offsets[i + 1]);
+		}
+	};
+	std::vector< std::shared_ptr<const Segment> > segments;
+	int nodeCount;
+
+	/// what the segments were built from, so that a later Build on the same pool only adds the sets appended since
+	const RRPool* source;
+	size_t sourceGeneration;
+	size_t first;
+	size_t stride;
+	/// label of the indexed sets, or -1 for sets by position
+	int label;
+	/// items indexed so far (sets scanned so far for labelled sets)
+	size_t itemCount;
+	/// the ids added by the last Build are >= this, and in the segments from firstNewSegment on
+	int firstNewId;
+	size_t firstNewSegment;
+
+	/// Whether the segments cover the first itemCount items of this selection of pool
+	bool _IsPrefixOf(const RRPool& pool, int n, size_t first, size_t stride, int label) const
+	{
+		return source == &pool && sourceGeneration == pool.Generation() && NodeCount() == n
+			&& this->first == first && this->stride == stride && this->label == label;
+	}
+
+	/// Start anew on this selection of pool
+	void _Reset(const RRPool& pool, int n, size_t first, size_t stride, int label);
+
+	/// Merge the segments a and b, b after a, into one: the ids of a node in a come first
+	static std::shared_ptr<const Segment> _Merge(const Segment& a, const Segment& b, bool isConcurrent);
+
+	/// Merge the last segment into the one before while it is not below half its size,
+	/// or while there is no room for a new segment
+	void _Compact(bool isConcurrent);
+
+	/// Index count new items, after the indexed ones, in a new segment: item j is the set pool[sets[j]]
+	/// with id sets[j] if sets is given, and the set pool[first + j * stride] with id j otherwise
+	void _Append(const RRPool& pool, int n, size_t firstItem, size_t count,
+		const std::vector<int>* sets, bool isConcurrent);
+
+	/// Start a Build: firstNewId and firstNewSegment are where the new sets go
+	void _BeginBuild(bool isConcurrent)
+	{
+		firstNewId = (int)itemCount;
+		_Compact(isConcurrent);
+		firstNewSegment = segments.size();
+	}
+
+public:
+	RRIndex() : nodeCount(0), source(NULL), sourceGeneration(0), first(0), stride(1), label(-1),
+		itemCount(0), firstNewId(0), firstNewSegment(0) {}
+
+	void clear()
+	{
+		segments.clear();
+		nodeCount = 0;
+		source = NULL;
+		itemCount = 0;
+		firstNewId = 0;
+		firstNewSegment = 0;
+	}
+
+	/// number of indexed nodes
+	int NodeCount() const { return nodeCount; }
+
+	List operator[](int v) const
+	{
+		List list;
+		for (size_t s = 0; s < segments.size(); ++s) segments[s]->AddTo(list, v);
+		return list;
+	}
+
+	/// Nodes of the sets added by the last Build: the i-th of them, i < AddedNodeCount(),
+	/// is AddedNode(i), with AddedCount(i) new ids (possibly 0)
+	size_t AddedNodeCount() const { return (firstNewSegment < segments.size()) ? segments.back()->ListCount() : 0; }
+	int AddedNode(size_t i) const { return segments.back()->Node(i); }
+	size_t AddedCount(size_t i) const { return segments.back()->ListSize(i); }
+
+	/// Ids added by the last Build are >= FirstNewId(), it is 0 if the index was built anew
+	int FirstNewId() const { return firstNewId; }
+
+	/// Index the sets pool[first + j * stride], j < count, under the id j
+	/// (all sets under their positions by default).
+	/// If the index holds a prefix of these sets, which are only appended to, just the new sets are added.
+	void Build(const RRPool& pool, int n, bool isConcurrent) { Build(pool, n, 0, 1, pool.size(), isConcurrent); }
+	void Build(const RRPool& pool, int n, size_t first, size_t stride, size_t count, bool isConcurrent);
+
+	/// Index the sets of pool labelled label, under their positions in pool.
+	/// Like Build, only the sets appended since the last call are scanned.
+	void BuildLabelled(const RRPool& pool, int n, int label, bool isConcurrent);
+};
+
+
+#endif // rr_index_h__
@@ -8,6 +8,9 @@
 #include <cassert>
 
 #include "rr_infl.h"
+#include "mi_bucket_queue.h"
+#include "mi_lazy_heap.h"
+#include "mi_argmax.h"
 #include "reverse_general_cascade.h"
 #include "graph.h"
 #include "event_timer.h"
@@ -50,6 +53,45 @@ public:
 	}
 };
 
+/// MaskedArgMax picks the last of equal counts, as max_element with the comparators above
+static const bool IS_LAST_ON_TIES = true;
+
+/// Number of RR sets drawn from one RNG stream (independent of the thread count)
+static const size_t RR_BLOCK_SIZE = 1024;
+
+/// Append the per-thread buffers to ref in thread order. The offsets of the buffers
+/// are a prefix sum over their sizes, so every thread copies its own range without locking.
+template <class T>
+static void MergeThreadBuffers(std::vector< std::vector<T> >& buffers, std::vector<T>& ref)
+{
+	int nBuffers = (int)buffers.size();
+	vector<size_t> offsets(nBuffers + 1, ref.size());
+	for (int t = 0; t < nBuffers; ++t) {
+		offsets[t + 1] = offsets[t] + buffers[t].size();
+	}
+	ref.resize(offsets[nBuffers]);
+
+#pragma omp parallel for
+	for (int t = 0; t < nBuffers; ++t) {
+		std::move(buffers[t].begin(), buffers[t].end(), ref.begin() + offsets[t]);
+		std::vector<T>().swap(buffers[t]);
+	}
+}
+
+/// Mark the ids of list in the coverage bitset, one bit per RR set.
+/// Returns how many of them were not marked before
+static size_t CoverIds(const RRIndex::List& list, std::vector<uint64_t>& covered)
+{
+	size_t count = 0;
+	for (int idx : list) {
+		uint64_t& word = covered[(size_t)idx >> 6];
+		uint64_t bit = (uint64_t)1 << (idx & 63);
+		count += (word & bit) == 0;
+		word |= bit;
+	}
+	return count;
+}
+
 void RRInflBase::InitializeConcurrent()
 {
 	if (isConcurrent)
@@ -74,81 +116,160 @@ void RRInflBase::InitializeConcurrent()
 
 void RRInflBase::_AddRRSimulation(size_t num_iter,
 	cascade_type& cascade,
-	std::vector< RRVec >& refTable,
+	RRPool& refTable,
 	std::vector<int>& refTargets)
 {
+	// serve the cached samples first, and store what is sampled beyond them
+	bool isCached = rrCache.Matches(0, 1, false);
+	if (isCached) {
+		num_iter -= rrCache.Take(num_iter, refTable, refTargets);
+		if (num_iter == 0) return;
+	}
+	size_t firstSet = refTable.size();
+	size_t firstTarget = refTargets.size();
+
 	vector<int> edgeVisited; // discard
 	_AddRRSimulation(num_iter, cascade, refTable, refTargets, edgeVisited);
+
+	if (isCached) rrCache.Put(refTable, firstSet, refTargets, firstTarget, sampleRound);
+}
+
+void RRInflBase::_OpenRRCache(graph_type& gf, int timeSlices, int setsPerSample, bool labelled)
+{
+	rrCache.Close();
+	if (rrCacheDir.empty()) return;
+
+	RRCache::Key key;
+	key.graphHash = RRCache::HashGraph(gf);
+	key.edgeForm = gf.edgeForm;
+	key.timeSlices = timeSlices;
+	key.seed = MIRandom::GetRunSeed();
+	key.setsPerSample = setsPerSample;
+	key.labelled = labelled ? 1 : 0;
+	key.batchSampling = isBatchSampling ? 1 : 0;
+	// continue after the rounds of the cached samples, so fresh samples use new streams
+	sampleRound = max(sampleRound, rrCache.Open(rrCacheDir, key));
+	if (rrCache.IsOpen()) {
+		cout << "  RR cache: " << rrCache.Path() << ", #samples = " << rrCache.SampleCount() << endl;
+	}
 }
 
 void RRInflBase::_AddRRSimulation(size_t num_iter,
 	cascade_type& cascade,
-	std::vector< RRVec >& refTable,
+	RRPool& refTable,
 	std::vector<int>& refTargets,
 	std::vector<int>& refEdgeVisited)
 {
+	if (refTable.empty()) refTable.SetCompressed(isCompressedRR);
+	// Samples are cut into blocks of RR_BLOCK_SIZE, and each block draws from its own stream
+	// keyed by (run seed, round, block). So the table does not depend on the number of threads.
+	int round = sampleRound++;
+	int numBlocks = (int)((num_iter + RR_BLOCK_SIZE - 1) / RR_BLOCK_SIZE);
+
 #ifdef MI_USE_OMP
 	if (!isConcurrent) {
 #endif
 		// run single thread
 
-		for (size_t iter = 0; iter < num_iter; ++iter) {
-			int id = cascade.GenRandomNode();
-			int edgeVisited;
-			cascade.ReversePropagate(1, id, refTable, edgeVisited);
-
-			refTargets.push_back(id);
-			refEdgeVisited.push_back(edgeVisited);
+		TraversalScratch scratch;
+		BatchTraversalScratch batchScratch;
+		for (int block = 0; block < numBlocks; ++block) {
+			MIRandom random(MIRandom::StreamSeed(round, block));
+			size_t blockSize = min(num_iter - (size_t)block * RR_BLOCK_SIZE, RR_BLOCK_SIZE);
+			_AddRRBlock(blockSize, cascade, random, refTable, refTargets, refEdgeVisited, scratch, batchScratch);
 		}
 
 #ifdef MI_USE_OMP
 	}
 	else {
-		// run concurrently
-		// #pragma omp parallel for private(iter, id, edge_visited_count, tmpTable) shared(refTable, refTargets, refEdgeVisited)
-
-#pragma omp parallel for ordered
-		for (int iter = 0; iter < num_iter; ++iter) {
-			int id = cascade.GenRandomNode();
-			int edgeVisited;
-			vector<RRVec> tmpTable;
-			cascade.ReversePropagate(1, id, tmpTable, edgeVisited);
-#pragma omp critical
-			{
-				refTable.push_back(tmpTable[0]);
-				refTargets.push_back(id);
-				refEdgeVisited.push_back(edgeVisited);
+		// run concurrently, each thread owns the stream of its block
+		// and appends into its own buffers, which are merged once at the end.
+		// static schedule keeps the blocks of a thread contiguous, so the merged table is in block order.
+		int nThreads = omp_get_max_threads();
+		vector<RRPool> localTables(nThreads, RRPool(refTable.IsCompressed()));
+		vector< vector<int> > localTargets(nThreads), localEdgeVisited(nThreads);
+
+#pragma omp parallel
+		{
+			int tid = omp_get_thread_num();
+			TraversalScratch scratch;
+			BatchTraversalScratch batchScratch;
+			RRPool& tmpTable = localTables[tid];
+			vector<int>& tmpTargets = localTargets[tid];
+			vector<int>& tmpEdgeVisited = localEdgeVisited[tid];
+
+#pragma omp for schedule(static)
+			for (int block = 0; block < numBlocks; ++block) {
+				MIRandom random(MIRandom::StreamSeed(round, block));
+				size_t blockSize = min(num_iter - (size_t)block * RR_BLOCK_SIZE, RR_BLOCK_SIZE);
+				_AddRRBlock(blockSize, cascade, random, tmpTable, tmpTargets, tmpEdgeVisited, scratch, batchScratch);
 			}
 		}
+
+		refTable.Concat(localTables);
+		MergeThreadBuffers(localTargets, refTargets);
+		MergeThreadBuffers(localEdgeVisited, refEdgeVisited);
 	}
 #endif
 
 }
 
-void RRInflBase::_RebuildRRIndices()
+void RRInflBase::_AddRRBlock(size_t num_iter,
+	cascade_type& cascade,
+	MIRandom& random,
+	RRPool& refTable,
+	std::vector<int>& refTargets,
+	std::vector<int>& refEdgeVisited,
+	TraversalScratch& scratch,
+	BatchTraversalScratch& batchScratch)
 {
-	degrees.clear();
-	degrees.resize(n, 0);
-	degreeRRIndices.clear();
+	if (!isBatchSampling) {
+		for (size_t iter = 0; iter < num_iter; ++iter) {
+			int id = cascade.GenRandomNode(random);
+			int edgeVisited;
+			cascade.ReversePropagate(1, id, refTable, edgeVisited, random, scratch);
+
+			refTargets.push_back(id);
+			refEdgeVisited.push_back(edgeVisited);
+		}
+		return;
+	}
 
-	for (int i = 0; i < n; ++i) {
-		degreeRRIndices.push_back(vector<int>());
+	// draw the targets first, then traverse them BATCH_SIZE at a time
+	size_t firstTarget = refTargets.size();
+	size_t firstVisited = refEdgeVisited.size();
+	for (size_t iter = 0; iter < num_iter; ++iter) {
+		refTargets.push_back(cascade.GenRandomNode(random));
+	}
+	refEdgeVisited.resize(firstVisited + num_iter);
+	for (size_t iter = 0; iter < num_iter; iter += cascade_type::BATCH_SIZE) {
+		int count = (int)min((size_t)cascade_type::BATCH_SIZE, num_iter - iter);
+		cascade.ReversePropagateBatch(&refTargets[firstTarget + iter], count, refTable,
+			&refEdgeVisited[firstVisited + iter], random, batchScratch);
 	}
+}
 
+void RRInflBase::_RebuildRRIndices()
+{
 	// to count hyper edges:
-	for (size_t i = 0; i < table.size(); ++i) {
-		const RRVec& RR = table[i];
-		for (int source : RR) {
-			degrees[source]++;
-			degreeRRIndices[source].push_back(i); // add index of table
-		}
+	// the counts of the sets indexed before are kept, only the new sets are added
+	degreeRRIndices.Build(table, n, isConcurrent);
+	if (degreeRRIndices.FirstNewId() == 0) baseDegrees.assign(n, 0);
+	int added = (int)degreeRRIndices.AddedNodeCount();
+#pragma omp parallel for schedule(static) if(isConcurrent)
+	for (int i = 0; i < added; ++i) {
+		baseDegrees[degreeRRIndices.AddedNode(i)] += (int)degreeRRIndices.AddedCount(i);
 	}
-
-	// add to sourceSet where node's degree > 0
-	sourceSet.clear();
-	for (size_t i = 0; i < degrees.size(); ++i) {
-		if (degrees[i] >= 0) {
-			sourceSet.insert(i);
+	degrees = baseDegrees;
+
+	// add to sourceSet where node's degree > 0.
+	// the counts never drop below 0, so the set only changes with n
+	if (sourceSet.size() != (size_t)n) {
+		sourceSet.clear();
+		for (size_t i = 0; i < degrees.size(); ++i) {
+			if (degrees[i] >= 0) {
+				sourceSet.insert(i);
+			}
 		}
 	}
 }
@@ -166,13 +287,15 @@ double RRInflBase::_RunGreedy(int seed_size,
 	vector<bool> enables;
 	enables.resize(table.size(), true);
 
-	set<int> candidates(sourceSet);
-	CountComparator comp(degrees);
+	// candidates bucketed by their counts, kept in step with the deductions below.
+	// ties go to the largest id, as with CountComparator
+	BucketQueue candidates(true);
+	candidates.Build(sourceSet.begin(), sourceSet.end(), degrees);
 
 	double spread = 0;
 	for (int iter = 0; iter < seed_size; ++iter) {
-		set<int>::const_iterator maxPt = max_element(candidates.begin(), candidates.end(), comp);
-		int maxSource = *maxPt;
+		int maxSource = candidates.PopMax(degrees);
+		assert(maxSource >= 0);
 		// std::cout << "" << maxSource << "\t";
 		assert(degrees[maxSource] >= 0);
 
@@ -190,15 +313,14 @@ double RRInflBase::_RunGreedy(int seed_size,
 		outEstSpread.push_back(spread);
 
 		// clear values
-		candidates.erase(maxPt);
 		degrees[maxSource] = -1;
 
 		// deduct the counts from the rest nodes
-		const vector<int>& idxList = degreeRRIndices[maxSource];
+		RRIndex::List idxList = degreeRRIndices[maxSource];
 		if (!isConcurrent) {
 			for (int idx : idxList) {
 				if (enables[idx]) {
-					const RRVec& RRset = table[idx];
+					RRSpan RRset = table[idx];
 					for (int rr : RRset) {
 						if (rr == maxSource) continue;
 						degrees[rr]--; // deduct
@@ -209,11 +331,12 @@ double RRInflBase::_RunGreedy(int seed_size,
 		}
 		else {
 			// run concurrently
+			int idxCount = (int)idxList.size();
 #pragma omp parallel for
-			for (int idxIter = 0; idxIter < idxList.size(); ++idxIter) {
+			for (int idxIter = 0; idxIter < idxCount; ++idxIter) {
 				int idx = idxList[idxIter];
 				if (enables[idx]) {
-					const RRVec& RRset = table[idx];
+					RRSpan RRset = table[idx];
 					for (int rr : RRset) {
 						if (rr == maxSource) continue;
 
@@ -255,25 +378,58 @@ void RRInflBase::_SetResults(const vector<int>& seeds, const vector<double>& cum
 // Same thing has been implemented as a part of _Greedy
 double RRInflBase::_EstimateInfl(const vector<int>& seeds, vector<double>& out_cumu_spread)
 {
-	set<int> covered;
+	vector<uint64_t> covered((table.size() + 63) / 64, 0);
+	size_t coveredCount = 0;
 	double spd = 0;
 
-	vector<bool> enables;
-	enables.resize(table.size(), true);
 	for (size_t i = 0; i < seeds.size(); ++i) {
-		int sd = seeds[i];
-		for (int idx : degreeRRIndices[sd]) {
-			if (enables[idx]) {
-				covered.insert(idx);
-				enables[idx] = false;
-			}
-		}
-		spd = (double)(n * covered.size()) / table.size();
+		coveredCount += CoverIds(degreeRRIndices[seeds[i]], covered);
+		spd = (double)(n * coveredCount) / table.size();
 		out_cumu_spread.push_back(spd);
 	}
 	return spd;
 }
 
+vector<double> RRInflBase::EstimateSpreads(const vector< vector<int> >& seedSets)
+{
+	// the RR sets are read from table in one pass, the indices and counts of the greedy are left alone
+	vector<double> spreads(seedSets.size(), 0.0);
+	if (table.empty()) return spreads;
+
+	int nSets = (int)seedSets.size();
+	vector< vector<int> > setsOf(n); // the seed sets holding each node
+	for (int s = 0; s < nSets; ++s) {
+		for (int sd : seedSets[s]) {
+			if (sd >= 0 && sd < n) setsOf[sd].push_back(s);
+		}
+	}
+
+	vector<size_t> covered(nSets, 0);
+	int nRR = (int)table.size();
+#pragma omp parallel if(isConcurrent)
+	{
+		// an RR set counts once per seed set: lastRR[s] is the last one counted for s
+		vector<size_t> counts(nSets, 0);
+		vector<int> lastRR(nSets, -1);
+#pragma omp for schedule(static)
+		for (int i = 0; i < nRR; ++i) {
+			for (int v : table[i]) {
+				for (int s : setsOf[v]) {
+					if (lastRR[s] == i) continue;
+					lastRR[s] = i;
+					counts[s]++;
+				}
+			}
+		}
+#pragma omp critical
+		for (int s = 0; s < nSets; ++s) covered[s] += counts[s];
+	}
+	for (int s = 0; s < nSets; ++s) {
+		spreads[s] = (double)(n * covered[s]) / table.size();
+	}
+	return spreads;
+}
+
 
 
 ////////////////////////////////////////////////////////////////////
@@ -741,6 +897,7 @@ void PRM_IMM::_Build(graph_type& gf, int k, int time, cascade_type& cascade, dou
 
 	table.clear();
 	targets.clear();
+	_OpenRRCache(gf, 0, 1, false);
 
 	double epsprime = eps * sqrt(2.0); // eps'
 	double LB = 1.0;   // lower bound
@@ -918,6 +1075,7 @@ void PRM_IMM::_Build(graph_type& gf, int k, int time, cascade_type& cascade, dou
 		stept.SetTimeEvent("step_end");
 		steptimers.push_back(stept);
 	}
+	rrCache.Close();
 	pctimer.SetTimeEvent("end");
 
 	// Write results to file:
@@ -965,6 +1123,7 @@ void PRM_IMM::Build(graph_type& gf, int k, int time, cascade_type& cascade, doub
 	table.clear();
 	tableWithTime.clear();
 	targets.clear();
+	_OpenRRCache(gf, time, 1, true);
 
 	double sum_weight = 0.0;
 	for (int i = 0; i < time; i++)
@@ -1098,6 +1257,7 @@ void PRM_IMM::Build(graph_type& gf, int k, int time, cascade_type& cascade, doub
 		stept.SetTimeEvent("step_end");
 		steptimers.push_back(stept);
 	}
+	rrCache.Close();
 	pctimer.SetTimeEvent("end");
 
 	// Write results to file:
@@ -1181,46 +1341,102 @@ double PRM_IMM::LambdaStarOrigin(double eps, int k, double ell, int n)
 
 void PRM_IMM::_AddRRSimulation1(size_t num_iter,
 	cascade_type& cascade,
-	std::vector< pair< RRVec, int > >& refTable,
+	RRPool& refTable,
 	std::vector<int>& refTargets,
 	int k)
 {
+	if (refTable.empty()) refTable.SetCompressed(isCompressedRR);
+	// serve the cached samples first, and store what is sampled beyond them
+	bool isCached = rrCache.Matches(k, 1, true);
+	if (isCached) {
+		num_iter -= rrCache.Take(num_iter, refTable, refTargets);
+		if (num_iter == 0) return;
+	}
+	size_t firstSet = refTable.size();
+	size_t firstTarget = refTargets.size();
+
+	// same block-keyed streams as _AddRRSimulation
+	int round = sampleRound++;
+	int numBlocks = (int)((num_iter + RR_BLOCK_SIZE - 1) / RR_BLOCK_SIZE);
+
 #ifdef MI_USE_OMP
 	if (!isConcurrent) {
 #endif
 		// run single thread
 
-		for (size_t iter = 0; iter < num_iter; ++iter) {
-			int id = cascade.GenRandomNode();
-			int edgeVisited; //好像没用
-			cascade.ReversePropagate(1, id, refTable, edgeVisited, k - 1); //refTable 就是tablewithtime，也就是返回的反向可达集pair的集合。
-
-			refTargets.push_back(id);
-			// refEdgeVisited.push_back(edgeVisited);
+		TraversalScratch scratch;
+		BatchTraversalScratch batchScratch;
+		for (int block = 0; block < numBlocks; ++block) {
+			MIRandom random(MIRandom::StreamSeed(round, block));
+			size_t blockSize = min(num_iter - (size_t)block * RR_BLOCK_SIZE, RR_BLOCK_SIZE);
+			_AddRRBlockWithTime(blockSize, cascade, random, refTable, refTargets, k, scratch, batchScratch);
 		}
 
 #ifdef MI_USE_OMP
 	}
 	else {
-		// run concurrently
-		// #pragma omp parallel for private(iter, id, edge_visited_count, tmpTable) shared(refTable, refTargets, refEdgeVisited)
+		// run concurrently, each thread owns the stream of its block
+		// and appends into its own buffers (see _AddRRSimulation)
+		int nThreads = omp_get_max_threads();
+		vector<RRPool> localTables(nThreads, RRPool(refTable.IsCompressed()));
+		vector< vector<int> > localTargets(nThreads);
 
-#pragma omp parallel for ordered
-		for (int iter = 0; iter < num_iter; ++iter) {
-			int id = cascade.GenRandomNode();
-			int edgeVisited;
-
-			vector< pair< RRVec, int > > tmpTable;
-			cascade.ReversePropagate(1, id, tmpTable, edgeVisited, k - 1);
-#pragma omp critical
-			{
-				refTable.push_back(tmpTable[0]);
-				refTargets.push_back(id);
+#pragma omp parallel
+		{
+			int tid = omp_get_thread_num();
+			TraversalScratch scratch;
+			BatchTraversalScratch batchScratch;
+			RRPool& tmpTable = localTables[tid];
+			vector<int>& tmpTargets = localTargets[tid];
+
+#pragma omp for schedule(static)
+			for (int block = 0; block < numBlocks; ++block) {
+				MIRandom random(MIRandom::StreamSeed(round, block));
+				size_t blockSize = min(num_iter - (size_t)block * RR_BLOCK_SIZE, RR_BLOCK_SIZE);
+				_AddRRBlockWithTime(blockSize, cascade, random, tmpTable, tmpTargets, k, scratch, batchScratch);
 			}
 		}
+
+		refTable.Concat(localTables);
+		MergeThreadBuffers(localTargets, refTargets);
 	}
 #endif
 
+	if (isCached) rrCache.Put(refTable, firstSet, refTargets, firstTarget, sampleRound);
+}
+
+void PRM_IMM::_AddRRBlockWithTime(size_t num_iter,
+	cascade_type& cascade,
+	MIRandom& random,
+	RRPool& refTable,
+	std::vector<int>& refTargets,
+	int k,
+	TraversalScratch& scratch,
+	BatchTraversalScratch& batchScratch)
+{
+	if (!isBatchSampling) {
+		for (size_t iter = 0; iter < num_iter; ++iter) {
+			int id = cascade.GenRandomNode(random);
+			int edgeVisited; //好像没用
+			cascade.ReversePropagate(1, id, refTable, edgeVisited, k - 1, random, scratch); //refTable 就是tablewithtime，也就是返回的反向可达集pair的集合。
+
+			refTargets.push_back(id);
+		}
+		return;
+	}
+
+	// draw targets and times first, then traverse them BATCH_SIZE at a time
+	size_t firstTarget = refTargets.size();
+	std::vector<int> times(num_iter);
+	for (size_t iter = 0; iter < num_iter; ++iter) {
+		refTargets.push_back(cascade.GenRandomNode(random));
+		times[iter] = random.RandInt(0, k - 1);
+	}
+	for (size_t iter = 0; iter < num_iter; iter += cascade_type::BATCH_SIZE) {
+		int count = (int)min((size_t)cascade_type::BATCH_SIZE, num_iter - iter);
+		cascade.ReversePropagateBatch(&refTargets[firstTarget + iter], count, refTable,
+			NULL, random, batchScratch, &times[iter]);
+	}
 }
 
 
@@ -1228,33 +1444,34 @@ void PRM_IMM::_RebuildRRIndicesWithTime()
 {
 	RR_number.clear();
 	RR_number.resize(top, 0);   //保存不同时间的反向可达集的数量
-	degreesWithTime.clear();
-	vector<double> temp(n);
-	degreesWithTime.resize(top, temp); //k's value  分别保存不同时间，不同节点的影响力扩展度。
-	degreeRRIndicesWithTime.clear();  //分别保存不同时间，不同节点cover的反向可达集
-	vector< vector<int> > temp1;
-	temp1.clear();
-	for (int i = 0; i < n; ++i) {
-		temp1.push_back(vector<int>());
-	}
-	degreeRRIndicesWithTime.resize(top, temp1);
+	// the indices are kept across rounds, so that Build only adds the samples appended since
+	degreeRRIndicesWithTime.resize(top);  //分别保存不同时间，不同节点cover的反向可达集
+	baseDegreesWithTime.resize(top);
 
 
-	// to count hyper edges:
+	// to count hyper edges: the label of a set is its time
 	for (size_t i = 0; i < tableWithTime.size(); ++i) {
-		const pair< RRVec, int >& RR = tableWithTime[i];
-		RR_number[RR.second]++;
-		for (int source : RR.first) {
-			//double weight = 1.0 / (k_0 + m_0 * RR.second);
-			//double weight = 1.0;
-			//double weight = top - RR.second ;
-			double weight = Weight_iter(weight_mode, RR.second + 1);
-			degreesWithTime[RR.second][source] += weight;
-			degreeRRIndicesWithTime[RR.second][source].push_back(i); // add index of table
+		RR_number[tableWithTime.Label(i)]++;
+	}
+	for (int T = 0; T < top; T++) {
+		RRIndex& index = degreeRRIndicesWithTime[T];
+		index.BuildLabelled(tableWithTime, n, T, isConcurrent);
+		// the weight is added once per new set, as the greedy deducts it
+		double weight = Weight_iter(weight_mode, T + 1);
+		vector<double>& counts = baseDegreesWithTime[T];
+		if (index.FirstNewId() == 0) counts.assign(n, 0.0);
+		int added = (int)index.AddedNodeCount();
+#pragma omp parallel for schedule(static) if(isConcurrent)
+		for (int i = 0; i < added; ++i) {
+			double& count = counts[index.AddedNode(i)];
+			for (size_t c = index.AddedCount(i); c > 0; --c) count += weight;
 		}
 	}
+	degreesWithTime = baseDegreesWithTime; //k's value  分别保存不同时间，不同节点的影响力扩展度。
 
-	// add to sourceSet where node's degree > 0
+	// add to sourceSet where node's degree > 0.
+	// the counts never drop below 0, so the sets only change with the slices
+	if (sourceSetWithTime.size() == degreesWithTime.size() * n && sourceSet.size() == (size_t)n) return;
 	sourceSetWithTime.clear(); //
 	sourceSet.clear();
 	for (size_t i = 0; i < degreesWithTime.size(); ++i) {
@@ -1270,33 +1487,77 @@ void PRM_IMM::_RebuildRRIndicesWithTime()
 	}
 }
 
+vector<double> PRM_IMM::EstimateSchedules(const vector< vector< pair<int, int> > >& schedules)
+{
+	// the sets are read from tableWithTime in one pass, the indices and counts of the greedy are left alone
+	vector<double> spreads(schedules.size(), 0.0);
+	if (tableWithTime.empty()) return spreads;
+
+	int nTimes = top;
+	int nSchedules = (int)schedules.size();
+	vector< vector< pair<int, int> > > seedsOf(n); // (time, schedule) of the seeds at each node
+	for (int s = 0; s < nSchedules; ++s) {
+		for (const pair<int, int>& sd : schedules[s]) {
+			if (sd.second < 0 || sd.second >= nTimes || sd.first < 0 || sd.first >= n) continue;
+			seedsOf[sd.first].push_back(make_pair(sd.second, s));
+		}
+	}
+
+	// covered[s * nTimes + T]: sets of time T that schedule s covers, number[T]: all sets of time T
+	vector<size_t> covered((size_t)nSchedules * nTimes, 0);
+	vector<size_t> number(nTimes, 0);
+	int nRR = (int)tableWithTime.size();
+#pragma omp parallel if(isConcurrent)
+	{
+		// a set counts once per schedule: lastRR[s] is the last one counted for s
+		vector<size_t> counts(covered.size(), 0);
+		vector<size_t> numbers(nTimes, 0);
+		vector<int> lastRR(nSchedules, -1);
+#pragma omp for schedule(static)
+		for (int i = 0; i < nRR; ++i) {
+			int T = tableWithTime.Label(i);
+			if (T < 0 || T >= nTimes) continue;
+			numbers[T]++;
+			for (int v : tableWithTime[i]) {
+				for (const pair<int, int>& sd : seedsOf[v]) {
+					if (sd.first != T || lastRR[sd.second] == i) continue;
+					lastRR[sd.second] = i;
+					counts[(size_t)sd.second * nTimes + T]++;
+				}
+			}
+		}
+#pragma omp critical
+		{
+			for (size_t c = 0; c < covered.size(); ++c) covered[c] += counts[c];
+			for (int T = 0; T < nTimes; ++T) number[T] += numbers[T];
+		}
+	}
+
+	// a set of time T is worth n * w(T) / number[T], as the greedy counts it
+	for (int s = 0; s < nSchedules; ++s) {
+		double spread = 0;
+		for (int T = 0; T < nTimes; ++T) {
+			if (number[T] > 0) spread += (double)n * Weight_iter(weight_mode, T + 1) / number[T] * covered[(size_t)s * nTimes + T];
+		}
+		spreads[s] = spread;
+	}
+	return spreads;
+}
+
 void PRM_IMM::_RebuildRRIndicesWithReuse()
 {
 	degreesWithTime.clear();
 	vector<double> temp(n);
 	degreesWithTime.resize(max_time, temp); //k's value  分别保存不同时间，不同节点的影响力扩展度。
-	degreeRRIndicesWithTime.clear();  //分别保存不同时间，不同节点cover的反向可达集
-	vector< vector<int> > temp1;
-	temp1.clear();
-	for (int i = 0; i < n; ++i) {
-		temp1.push_back(vector<int>());
-	}
-	degreeRRIndicesWithTime.resize(max_time, temp1);
+	degreeRRIndicesWithTime.resize(max_time);  //分别保存不同时间，不同节点cover的反向可达集
 
 
-	// to count hyper edges:
-	for (size_t i = 0; i < table.size(); ++i) {
-		const RRVec& RR = table[i];
-		for (int source : RR) {
-			//double weight = 1.0 / (k_0 + m_0 * RR.second);
-			//double weight = 1.0;
-			//double weight = top - RR.second ;
-			//double weight = Weight_iter(weight_mode, 0 + 1);
-			degreesWithTime[0][source] += 1;
-			degreeRRIndicesWithTime[0][source].push_back(i); // add index of table
-		}
-	}
+	// to count hyper edges: slice 0 shares the index of table, which only adds the new sets
+	_RebuildRRIndices();
+	degreeRRIndicesWithTime[0] = degreeRRIndices;
+	degreesWithTime[0].assign(baseDegrees.begin(), baseDegrees.end());
 
+	// every slice deducts its own counts, while the lists of slice 0 are shared by all slices
 	for (int j = 1; j < max_time; j++)
 	{
 		degreesWithTime[j] = degreesWithTime[0];
@@ -1305,7 +1566,9 @@ void PRM_IMM::_RebuildRRIndicesWithReuse()
 	}
 
 
-	// add to sourceSet where node's degree > 0
+	// add to sourceSet where node's degree > 0.
+	// the counts never drop below 0, so the sets only change with the slices
+	if (sourceSetWithTime.size() == degreesWithTime.size() * n && sourceSet.size() == (size_t)n) return;
 	sourceSetWithTime.clear(); //
 	sourceSet.clear();
 	for (size_t i = 0; i < degreesWithTime.size(); ++i) {
@@ -1334,48 +1597,44 @@ double PRM_IMM::_RunGreedy1(int seed_size,
 	vector<bool> enables;
 	enables.resize(tableWithTime.size(), true);
 
-	set<int> candidates(sourceSet);
-	// dCountComparator comp(degreesWithTime[0]);  //edited
-	vector<dCountComparator> camp;
+	// per time slice, the candidates in a heap over their weighted counts, which the deductions
+	// below only lower. a seed leaves the candidates of every slice. ties go to the largest id
+	// within a slice and to the latest slice across slices, as with dCountComparator and PairdCountComparator
+	vector<bool> isCandidate(n, false);
+	for (int v : sourceSet) isCandidate[v] = true;
+	vector<LazyMaxHeap> candidatesWithTime(top, LazyMaxHeap(true));
 	for (int i = 0; i < top; i++) {
-		dCountComparator comp(degreesWithTime[i]);
-		camp.push_back(comp);
+		candidatesWithTime[i].Build(sourceSet.begin(), sourceSet.end(), degreesWithTime[i]);
 	}
 
 
 	double spread = 0;
 	int max_round = -1;
 	for (int iter = 0; iter < seed_size; ++iter) {
-		vector<pair<pair<double, int>, int>> winner; //记录每个时间上最大的节点
+		int winnerNode = -1, winnerTime = -1;
 		for (int i = 0; i < top; i++) {
-			set<int>::const_iterator maxPtIn = max_element(candidates.begin(), candidates.end(), camp[i]);
-			pair<pair<double, int>, int> maxSource;
-			maxSource.first.second = *maxPtIn;
-			maxSource.first.first = degreesWithTime[i][*maxPtIn];
-			maxSource.second = i;
-			winner.push_back(maxSource);
-		}
-		PairdCountComparator comp_end(winner);
-		set<int> Timecandidates;
-		for (int i = 0; i < top; i++)
-		{
-			Timecandidates.insert(i);
+			int v = candidatesWithTime[i].Top(degreesWithTime[i], isCandidate);
+			if (v < 0) continue;
+			if (winnerNode < 0 || degreesWithTime[i][v] >= degreesWithTime[winnerTime][winnerNode]) {
+				winnerNode = v;
+				winnerTime = i;
+			}
 		}
-		set<int>::const_iterator maxPt = max_element(Timecandidates.begin(), Timecandidates.end(), comp_end);
+		assert(winnerNode >= 0);
 		pair<int, int> maxSourceWithTime;
-		if(winner[*maxPt].second > max_round)
+		if(winnerTime > max_round)
 		{
-			maxSourceWithTime.first = winner[*maxPt].first.second; // node id
+			maxSourceWithTime.first = winnerNode; // node id
 			maxSourceWithTime.second = max_round + 1; // time(round)
 			max_round++;
 		}
 		else
 		{
-			maxSourceWithTime.first = winner[*maxPt].first.second; // node id
-			maxSourceWithTime.second = winner[*maxPt].second; // time(round)
+			maxSourceWithTime.first = winnerNode; // node id
+			maxSourceWithTime.second = winnerTime; // time(round)
 		}
 		// std::cout << "" << maxSource << "\t";
-		assert(degreesWithTime[winner[*maxPt].second][maxSourceWithTime.first] >= 0);
+		assert(degreesWithTime[winnerTime][maxSourceWithTime.first] >= 0);
 
 		// selected one node
 		outSeeds.push_back(maxSourceWithTime);
@@ -1391,16 +1650,16 @@ double PRM_IMM::_RunGreedy1(int seed_size,
 		outEstSpread.push_back(spread);
 
 		// clear values
-		candidates.erase(maxSourceWithTime.first);   //把选中的节点从预备节点中移除
+		isCandidate[maxSourceWithTime.first] = false;   //把选中的节点从预备节点中移除
 		//degreesWithTime[maxSourceWithTime.second][maxSourceWithTime.first] = -1;   似乎是多此一举
 
 		// deduct the counts from the rest nodes
-		const vector<int>& idxList = degreeRRIndicesWithTime[maxSourceWithTime.second][maxSourceWithTime.first];
+		RRIndex::List idxList = degreeRRIndicesWithTime[maxSourceWithTime.second][maxSourceWithTime.first];
 		if (!isConcurrent) {
 			for (int idx : idxList) {
 				if (enables[idx]) {
-					const pair<RRVec, int>& RRset = tableWithTime[idx];
-					for (int rr : RRset.first) {
+					RRSpan RRset = tableWithTime[idx];
+					for (int rr : RRset) {
 						if (rr == maxSourceWithTime.first) continue;
 						degreesWithTime[maxSourceWithTime.second][rr] -= Weight_iter(weight_mode, maxSourceWithTime.second + 1); // deduct
 					}
@@ -1410,12 +1669,13 @@ double PRM_IMM::_RunGreedy1(int seed_size,
 		}
 		else {
 			// run concurrently
+			int idxCount = (int)idxList.size();
 #pragma omp parallel for
-			for (int idxIter = 0; idxIter < idxList.size(); ++idxIter) {
+			for (int idxIter = 0; idxIter < idxCount; ++idxIter) {
 				int idx = idxList[idxIter];
 				if (enables[idx]) {
-					const pair<RRVec, int>& RRset = tableWithTime[idx];
-					for (int rr : RRset.first) {
+					RRSpan RRset = tableWithTime[idx];
+					for (int rr : RRset) {
 						if (rr == maxSourceWithTime.first) continue;
 
 #pragma omp atomic
@@ -1507,12 +1767,12 @@ double PRM_IMM::_RunGreedyTest(int seed_size,
 		//degreesWithTime[maxSourceWithTime.second][maxSourceWithTime.first] = -1;   似乎是多此一举
 
 		// deduct the counts from the rest nodes
-		const vector<int>& idxList = degreeRRIndicesWithTime[maxSourceWithTime.second][maxSourceWithTime.first];
+		RRIndex::List idxList = degreeRRIndicesWithTime[maxSourceWithTime.second][maxSourceWithTime.first];
 		if (!isConcurrent) {
 			for (int idx : idxList) {
 				if (enables[idx]) {
-					const pair<RRVec, int>& RRset = tableWithTime[idx];
-					for (int rr : RRset.first) {
+					RRSpan RRset = tableWithTime[idx];
+					for (int rr : RRset) {
 						if (rr == maxSourceWithTime.first) continue;
 						degreesWithTime[maxSourceWithTime.second][rr] -= Weight_iter(weight_mode, maxSourceWithTime.second + 1); // deduct
 					}
@@ -1522,12 +1782,13 @@ double PRM_IMM::_RunGreedyTest(int seed_size,
 		}
 		else {
 			// run concurrently
+			int idxCount = (int)idxList.size();
 #pragma omp parallel for
-			for (int idxIter = 0; idxIter < idxList.size(); ++idxIter) {
+			for (int idxIter = 0; idxIter < idxCount; ++idxIter) {
 				int idx = idxList[idxIter];
 				if (enables[idx]) {
-					const pair<RRVec, int>& RRset = tableWithTime[idx];
-					for (int rr : RRset.first) {
+					RRSpan RRset = tableWithTime[idx];
+					for (int rr : RRset) {
 						if (rr == maxSourceWithTime.first) continue;
 
 #pragma omp atomic
@@ -1646,13 +1907,14 @@ double PRM_IMM::FindTopK(int seed_size,
 	vector<bool> enables;
 	enables.resize(table.size(), true);
 
-	set<int> candidates(sourceSet);
-	CountComparator comp(degrees);
+	// candidates as a dense mask over the node ids, scanned by MaskedArgMax
+	vector<uint8_t> isCandidate(n, 0);
+	for (int v : sourceSet) isCandidate[v] = 1;
 
 	double spread = 0;
 	for (int iter = 0; iter < seed_size; ++iter) {
-		set<int>::const_iterator maxPt = max_element(candidates.begin(), candidates.end(), comp);
-		int maxSource = *maxPt;
+		int maxSource = MaskedArgMax(degrees.data(), isCandidate.data(), n, IS_LAST_ON_TIES);
+		assert(maxSource >= 0);
 		// std::cout << "" << maxSource << "\t";
 		assert(degrees[maxSource] >= 0);
 
@@ -1673,7 +1935,7 @@ double PRM_IMM::FindTopK(int seed_size,
 		outEstSpread.push_back(spread);
 
 		// clear values
-		candidates.erase(maxPt);
+		isCandidate[maxSource] = 0;
 		degrees[maxSource] = -1;
 
 		// deduct the counts from the rest nodes
@@ -1699,12 +1961,13 @@ double PRM_IMM::uniformChoose(int seed_size,
 
 
 
-	set<int> candidates(sourceSet);
+	// candidates as a dense mask over the node ids, scanned by MaskedArgMax
+	vector<uint8_t> isCandidate(n, 0);
+	for (int v : sourceSet) isCandidate[v] = 1;
 	//CountComparator comp(degrees);
 
 	double spread = 0;
 	for (int iter = 0; iter < max_time; ++iter) {
-		dCountComparator comp(degreesWithTime[iter]);
 		if (iter < more_number)
 		{
 			// set enables for table
@@ -1713,8 +1976,8 @@ double PRM_IMM::uniformChoose(int seed_size,
 			for (int j = 0; j < more; j++)
 			{
 
-				set<int>::const_iterator maxPt = max_element(candidates.begin(), candidates.end(), comp);
-				int maxSource = *maxPt;
+				int maxSource = MaskedArgMax(degreesWithTime[iter].data(), isCandidate.data(), n, IS_LAST_ON_TIES);
+				assert(maxSource >= 0);
 				// std::cout << "" << maxSource << "\t";
 				assert(degreesWithTime[iter][maxSource] >= 0);
 
@@ -1735,15 +1998,15 @@ double PRM_IMM::uniformChoose(int seed_size,
 				outEstSpread.push_back(spread);
 
 				// clear values
-				candidates.erase(maxSource);
+				isCandidate[maxSource] = 0;
 				degreesWithTime[iter][maxSource] = -1;
 
 				// deduct the counts from the rest nodes
-				const vector<int>& idxList = degreeRRIndicesWithTime[iter][maxSource];
+				RRIndex::List idxList = degreeRRIndicesWithTime[iter][maxSource];
 				if (!isConcurrent) {
 					for (int idx : idxList) {
 						if (enables[idx]) {
-							const RRVec& RRset = table[idx];
+							RRSpan RRset = table[idx];
 							for (int rr : RRset) {
 								if (rr == maxSource) continue;
 								degreesWithTime[iter][rr] -= 1; // deduct
@@ -1754,11 +2017,12 @@ double PRM_IMM::uniformChoose(int seed_size,
 				}
 				else {
 					// run concurrently
+					int idxCount = (int)idxList.size();
 #pragma omp parallel for
-					for (int idxIter = 0; idxIter < idxList.size(); ++idxIter) {
+					for (int idxIter = 0; idxIter < idxCount; ++idxIter) {
 						int idx = idxList[idxIter];
 						if (enables[idx]) {
-							const RRVec& RRset = table[idx];
+							RRSpan RRset = table[idx];
 							for (int rr : RRset) {
 								if (rr == maxSource) continue;
 
@@ -1779,8 +2043,8 @@ double PRM_IMM::uniformChoose(int seed_size,
 			for (int j = 0; j < less; j++)
 			{
 
-				set<int>::const_iterator maxPt = max_element(candidates.begin(), candidates.end(), comp);
-				int maxSource = *maxPt;
+				int maxSource = MaskedArgMax(degreesWithTime[iter].data(), isCandidate.data(), n, IS_LAST_ON_TIES);
+				assert(maxSource >= 0);
 				// std::cout << "" << maxSource << "\t";
 				assert(degreesWithTime[iter][maxSource] >= 0);
 
@@ -1801,15 +2065,15 @@ double PRM_IMM::uniformChoose(int seed_size,
 				outEstSpread.push_back(spread);
 
 				// clear values
-				candidates.erase(maxSource);
+				isCandidate[maxSource] = 0;
 				degreesWithTime[iter][maxSource] = -1;
 
 				// deduct the counts from the rest nodes
-				const vector<int>& idxList = degreeRRIndicesWithTime[iter][maxSource];
+				RRIndex::List idxList = degreeRRIndicesWithTime[iter][maxSource];
 				if (!isConcurrent) {
 					for (int idx : idxList) {
 						if (enables[idx]) {
-							const RRVec& RRset = table[idx];
+							RRSpan RRset = table[idx];
 							for (int rr : RRset) {
 								if (rr == maxSource) continue;
 								degreesWithTime[iter][rr] -= 1; // deduct
@@ -1820,11 +2084,12 @@ double PRM_IMM::uniformChoose(int seed_size,
 				}
 				else {
 					// run concurrently
+					int idxCount = (int)idxList.size();
 #pragma omp parallel for
-					for (int idxIter = 0; idxIter < idxList.size(); ++idxIter) {
+					for (int idxIter = 0; idxIter < idxCount; ++idxIter) {
 						int idx = idxList[idxIter];
 						if (enables[idx]) {
-							const RRVec& RRset = table[idx];
+							RRSpan RRset = table[idx];
 							for (int rr : RRset) {
 								if (rr == maxSource) continue;
 
@@ -1891,20 +2156,21 @@ double PRM_IMM::DecreasingChoose(int seed_size,
 		decreasing_list.resize(max_time);
 	}
 
-	set<int> candidates(sourceSet);
+	// candidates as a dense mask over the node ids, scanned by MaskedArgMax
+	vector<uint8_t> isCandidate(n, 0);
+	for (int v : sourceSet) isCandidate[v] = 1;
 	//CountComparator comp(degrees);
 
 	double spread = 0;
 	for (int iter = 0; iter < decreasing_list.size(); iter++) {
-		dCountComparator comp(degreesWithTime[iter]);
 		// set enables for table
 		vector<bool> enables;
 		enables.resize(table.size(), true);
 		for (int j = 0; j < decreasing_list[iter]; j++)
 		{
 
-			set<int>::const_iterator maxPt = max_element(candidates.begin(), candidates.end(), comp);
-			int maxSource = *maxPt;
+			int maxSource = MaskedArgMax(degreesWithTime[iter].data(), isCandidate.data(), n, IS_LAST_ON_TIES);
+			assert(maxSource >= 0);
 			// std::cout << "" << maxSource << "\t";
 			assert(degreesWithTime[iter][maxSource] >= 0);
 
@@ -1925,15 +2191,15 @@ double PRM_IMM::DecreasingChoose(int seed_size,
 			outEstSpread.push_back(spread);
 
 			// clear values
-			candidates.erase(maxSource);
+			isCandidate[maxSource] = 0;
 			degreesWithTime[iter][maxSource] = -1;
 
 			// deduct the counts from the rest nodes
-			const vector<int>& idxList = degreeRRIndicesWithTime[iter][maxSource];
+			RRIndex::List idxList = degreeRRIndicesWithTime[iter][maxSource];
 			if (!isConcurrent) {
 				for (int idx : idxList) {
 					if (enables[idx]) {
-						const RRVec& RRset = table[idx];
+						RRSpan RRset = table[idx];
 						for (int rr : RRset) {
 							if (rr == maxSource) continue;
 							degreesWithTime[iter][rr] -= 1; // deduct
@@ -1944,11 +2210,12 @@ double PRM_IMM::DecreasingChoose(int seed_size,
 			}
 			else {
 				// run concurrently
+				int idxCount = (int)idxList.size();
 #pragma omp parallel for
-				for (int idxIter = 0; idxIter < idxList.size(); ++idxIter) {
+				for (int idxIter = 0; idxIter < idxCount; ++idxIter) {
 					int idx = idxList[idxIter];
 					if (enables[idx]) {
-						const RRVec& RRset = table[idx];
+						RRSpan RRset = table[idx];
 						for (int rr : RRset) {
 							if (rr == maxSource) continue;
 
@@ -1974,7 +2241,9 @@ double PRM_IMM::reuseRunGreedy(int seed_size,
 	outSeeds.clear();
 	outEstSpread.clear();
 
-	set<int> candidates(sourceSet);
+	// candidates as a dense mask over the node ids, scanned by MaskedArgMax
+	vector<uint8_t> isCandidate(n, 0);
+	for (int v : sourceSet) isCandidate[v] = 1;
 	double spread = 0;
 	int seed_size_temp = 0;
 	seed_size_temp = seed_size;
@@ -1989,14 +2258,13 @@ double PRM_IMM::reuseRunGreedy(int seed_size,
 	}
 	for (int iter = 0; iter < max_time; iter++)
 	{
-		dCountComparator comp(degreesWithTime[iter]);
 		// set enables for table
 		vector<bool> enables;
 		enables.resize(table.size(), true);
 		for (int j = 0; j < seize_size[iter]; j++)
 		{
-			set<int>::const_iterator maxPt = max_element(candidates.begin(), candidates.end(), comp);
-			int maxSource = *maxPt;
+			int maxSource = MaskedArgMax(degreesWithTime[iter].data(), isCandidate.data(), n, IS_LAST_ON_TIES);
+			assert(maxSource >= 0);
 			// std::cout << "" << maxSource << "\t";
 			assert(degreesWithTime[iter][maxSource] >= 0);
 
@@ -2017,15 +2285,15 @@ double PRM_IMM::reuseRunGreedy(int seed_size,
 			outEstSpread.push_back(spread);
 
 			// clear values
-			candidates.erase(maxPt);
+			isCandidate[maxSource] = 0;
 			degreesWithTime[iter][maxSource] = -1;
 
 			// deduct the counts from the rest nodes
-			const vector<int>& idxList = degreeRRIndicesWithTime[iter][maxSource];
+			RRIndex::List idxList = degreeRRIndicesWithTime[iter][maxSource];
 			if (!isConcurrent) {
 				for (int idx : idxList) {
 					if (enables[idx]) {
-						const RRVec& RRset = table[idx];
+						RRSpan RRset = table[idx];
 						for (int rr : RRset) {
 							if (rr == maxSource) continue;
 							degreesWithTime[iter][rr] -= 1; // deduct
@@ -2036,11 +2304,12 @@ double PRM_IMM::reuseRunGreedy(int seed_size,
 			}
 			else {
 				// run concurrently
+				int idxCount = (int)idxList.size();
 #pragma omp parallel for
-				for (int idxIter = 0; idxIter < idxList.size(); ++idxIter) {
+				for (int idxIter = 0; idxIter < idxCount; ++idxIter) {
 					int idx = idxList[idxIter];
 					if (enables[idx]) {
-						const RRVec& RRset = table[idx];
+						RRSpan RRset = table[idx];
 						for (int rr : RRset) {
 							if (rr == maxSource) continue;
 
@@ -10,6 +10,9 @@
 #include "graph.h"
 #include "common.h"
 #include "reverse_general_cascade.h"
+#include "rr_pool.h"
+#include "rr_index.h"
+#include "rr_cache.h"
 #include "algo_base.h"
 #include "general_cascade.h"
 
@@ -22,35 +25,62 @@ public:
 	typedef Graph graph_type;
 	typedef ReverseGCascade cascade_type;
 
-	RRInflBase() : m(0),
-		isConcurrent(false) {
+	RRInflBase() : isConcurrent(false), isBatchSampling(false), isCompressedRR(false),
+		m(0), sampleRound(0) {
 	}
 
 	// for concurrent optimization: using omp
 	bool isConcurrent; // turn on to use openmp
+	// sample RR sets in bit-parallel batches (ReverseGCascadeT::ReversePropagateBatch)
+	bool isBatchSampling;
+	// store RR sets packed (see RRPool), trades decoding time for memory
+	bool isCompressedRR;
+	// directory of the RR sample cache (see RRCache), empty to sample every run from scratch
+	std::string rrCacheDir;
+
+	/// Estimated spread n * (covered RR sets) / (all RR sets) of every seed set in seedSets,
+	/// on the RR sets of the last Build. The sets are scored in parallel if isConcurrent
+	std::vector<double> EstimateSpreads(const std::vector< std::vector<int> >& seedSets);
 
 protected:
 	int m;
+	/// counter of sampling calls, used to key the RNG streams of each call
+	int sampleRound;
 
-	std::vector< RRVec > table;
+	RRPool table;
 	std::vector<int> targets;
 	// degree of hyper-edges v, where e(u, v) in the hyper graph
 	// source id --> degrees
 	std::vector<int> degrees;
-	std::vector< std::vector<int> > degreeRRIndices;
+	std::vector<int> baseDegrees; // c[v] of all indexed sets, before the greedy deducts
+	RRIndex degreeRRIndices;
 	std::set<int> sourceSet; // all the source node ids
 
 	void InitializeConcurrent();
 
+	/// samples of the running Build, reused across runs (see RRCache)
+	RRCache rrCache;
+	/// Open the cache of the samples Build draws: timeSlices is 0 for plain RR sets
+	void _OpenRRCache(graph_type& gf, int timeSlices, int setsPerSample, bool labelled);
+
 	void _AddRRSimulation(size_t num_iter,
 		cascade_type& cascade,
-		std::vector< RRVec >& refTable,
+		RRPool& refTable,
 		std::vector<int>& refTargets);
 	void _AddRRSimulation(size_t num_iter,
 		cascade_type& cascade,
-		std::vector< RRVec >& refTable,
+		RRPool& refTable,
 		std::vector<int>& refTargets,
 		std::vector<int>& refEdgeVisited);
+	/// Samples the num_iter RR sets of one block from its stream
+	void _AddRRBlock(size_t num_iter,
+		cascade_type& cascade,
+		MIRandom& random,
+		RRPool& refTable,
+		std::vector<int>& refTargets,
+		std::vector<int>& refEdgeVisited,
+		TraversalScratch& scratch,
+		BatchTraversalScratch& batchScratch);
 
 	double _RunGreedy(int seed_size,
 		std::vector<int>& outSeeds,
@@ -162,9 +192,17 @@ public:
 		std::vector<double>& outEstSpread);
 	void _AddRRSimulation1(size_t num_iter,
 		cascade_type& cascade,
-		std::vector< std::pair< RRVec, int > >& refTable,
+		RRPool& refTable,
 		std::vector<int>& refTargets,
 		int k);
+	void _AddRRBlockWithTime(size_t num_iter,
+		cascade_type& cascade,
+		MIRandom& random,
+		RRPool& refTable,
+		std::vector<int>& refTargets,
+		int k,
+		TraversalScratch& scratch,
+		BatchTraversalScratch& batchScratch);
 
 	void _RebuildRRIndicesWithTime();
 	void _RebuildRRIndicesWithReuse();
@@ -188,6 +226,12 @@ public:
 		std::vector< std::pair< int, int > >& outSeeds,
 		std::vector<double>& outEstSpread);
 	double Weight_iter(int weight_mode, int time);
+	/// Estimated spread of every (node, time) schedule on the RR sets of the last Build,
+	/// as _RunGreedy1 counts it: a covered set of time T is worth n * w(T) / RR_number[T].
+	/// The schedules are scored in parallel if isConcurrent
+	std::vector<double> EstimateSchedules(const std::vector< std::vector< std::pair<int, int> > >& schedules);
+	/// PRM ratio of an estimated spread, as Build reports it
+	double PRMRatio(double spread) const { return (spread + 1.0) * (1.0 + kb_0 / kp_0) - 1.0; }
 	void _SetResults1(const std::vector<std::pair<int, int>>& seeds, const std::vector<double>& cumu_spread);
 	virtual void WriteToFileWithTime(const std::string& filename, IGraph& gf);
 	void Write(const std::string& filename,
@@ -204,8 +248,9 @@ protected:
 	std::vector<std::pair<int, int>> listWithTime;
 
 	std::vector< std::vector<double> > degreesWithTime; //c_t[v]
-	std::vector< std::pair< RRVec, int > > tableWithTime; // set of RR-set with label
-	std::vector< std::vector< std::vector<int> > > degreeRRIndicesWithTime; //RR_t[v]
+	std::vector< std::vector<double> > baseDegreesWithTime; // c_t[v] of all indexed sets, before the greedy deducts
+	RRPool tableWithTime; // set of RR-set with label
+	std::vector<RRIndex> degreeRRIndicesWithTime; //RR_t[v]
 	std::set<std::pair<int, int>> sourceSetWithTime;
 	std::vector<int> RR_number;
 };
@@ -0,0 +1,307 @@
+#ifndef rr_pool_h__
+#define rr_pool_h__
+
+#include <vector>
+#include <cassert>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include "common.h"
+#include "mi_scratch.h"
+
+
+/// Read-only view of one RR set stored in RRPool.
+/// A set is read front to back with a range-for; packed sets are decoded on the fly.
+class RRSpan
+{
+public:
+	/// Storage of a set, see RRPool
+	enum Encoding { RAW = 0, DELTA_VARINT = 1, BITMAP = 2 };
+
+	/// Read one LEB128 varint and move q past it
+	static inline uint32_t ReadVarint(const uint8_t*& q)
+	{
+		uint32_t v = *q++;
+		if (v < 0x80) return v;
+		v &= 0x7F;
+		int shift = 7;
+		uint8_t b;
+		do {
+			b = *q++;
+			v |= (uint32_t)(b & 0x7F) << shift;
+			shift += 7;
+		} while (b & 0x80);
+		return v;
+	}
+
+	/// Input iterator over the node ids of a set
+	class iterator
+	{
+	public:
+		typedef std::input_iterator_tag iterator_category;
+		typedef int value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const int* pointer;
+		typedef int reference;
+
+	protected:
+		const int* raw;
+		const uint8_t* packed;
+		size_t remaining;
+		int node;
+		int base;
+		uint32_t bits;
+		int encoding;
+
+		inline void Load()
+		{
+			if (encoding == RAW) {
+				node = *raw;
+			}
+			else if (encoding == DELTA_VARINT) {
+				node += (int)ReadVarint(packed);
+			}
+			else {
+				while (bits == 0) {
+					bits = *packed++;
+					base += 8;
+				}
+				node = base + LowestBitIndex(bits);
+				bits &= bits - 1;
+			}
+		}
+
+	public:
+		/// end iterator
+		iterator() : raw(NULL), packed(NULL), remaining(0), node(0), base(0), bits(0), encoding(RAW) {}
+
+		iterator(const int* raw, size_t count) : raw(raw), packed(NULL), remaining(count), node(0), base(0), bits(0), encoding(RAW)
+		{
+			if (remaining > 0) Load();
+		}
+
+		iterator(const uint8_t* packed, size_t count, int encoding, int base)
+			: raw(NULL), packed(packed), remaining(count), node(0), base(base), bits(0), encoding(encoding)
+		{
+			if (remaining > 0) Load();
+		}
+
+		int operator*() const { return node; }
+
+		iterator& operator++()
+		{
+			if (--remaining > 0) {
+				if (encoding == RAW) ++raw;
+				Load();
+			}
+			return *this;
+		}
+
+		bool operator!=(const iterator& other) const { return remaining != other.remaining; }
+		bool operator==(const iterator& other) const { return remaining == other.remaining; }
+	};
+
+protected:
+	iterator first;
+	size_t count;
+
+public:
+	/// Set stored as plain ints
+	RRSpan(const int* first, const int* last) : first(first, (size_t)(last - first)), count((size_t)(last - first)) {}
+
+	/// Set packed by RRPool::AppendPacked
+	explicit RRSpan(const uint8_t* q)
+	{
+		uint32_t header = ReadVarint(q);
+		count = header >> 2;
+		int encoding = (int)(header & 3);
+		if (encoding == BITMAP) {
+			// bit 0 of the first byte is node `low`, Load() moves base 8 ahead before reading a byte
+			int low = (int)ReadVarint(q);
+			first = iterator(q, count, encoding, low - 8);
+		}
+		else {
+			first = iterator(q, count, encoding, 0);
+		}
+	}
+
+	iterator begin() const { return first; }
+	iterator end() const { return iterator(); }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+};
+
+
+/// Contiguous pool of RR sets (CSR layout).
+/// The nodes of set i are nodes[offsets[i]] ... nodes[offsets[i+1]-1].
+/// Optionally every set carries an integer label (e.g. its time slice).
+///
+/// A compressed pool stores every set sorted, in packed[offsets[i]] ... packed[offsets[i+1]-1]:
+/// a varint header (size << 2 | encoding), then either the first id and the gaps as varints,
+/// or, if it is shorter, the lowest id and a bitmap of the ids above it.
+/// The order of the nodes inside a set is not kept.
+class RRPool
+{
+protected:
+	/// node ids of all sets, one after another
+	std::vector<int> nodes;
+	/// packed sets of a compressed pool
+	std::vector<uint8_t> packed;
+	/// start of each set in nodes (or packed), plus the end of the last one
+	std::vector<size_t> offsets;
+	/// per-set labels (empty if the pool is not labelled)
+	std::vector<int> labels;
+	/// number of node ids over all sets
+	size_t nodeCount;
+	bool compressed;
+	/// bumped whenever sets are removed, so that views built on the sets can tell (see RRIndex)
+	size_t generation;
+	/// sort buffer of AppendPacked
+	std::vector<int> sortBuffer;
+
+	/// Sort the count ids at ids and encode them into packed
+	void AppendPacked(int* ids, size_t count);
+
+	template <class TIter>
+	void AppendSet(TIter first, TIter last)
+	{
+		if (compressed) {
+			sortBuffer.assign(first, last);
+			AppendPacked(sortBuffer.data(), sortBuffer.size());
+		}
+		else {
+			size_t before = nodes.size();
+			nodes.insert(nodes.end(), first, last);
+			offsets.push_back(nodes.size());
+			nodeCount += nodes.size() - before;
+		}
+	}
+
+public:
+	explicit RRPool(bool compressed = false) : nodes(), packed(), offsets(1, 0), labels(), nodeCount(0), compressed(compressed), generation(0) {}
+
+	/// Number of RR sets
+	size_t size() const { return offsets.size() - 1; }
+	bool empty() const { return size() == 0; }
+	/// Number of node ids over all sets
+	size_t NodeCount() const { return nodeCount; }
+	bool HasLabels() const { return !labels.empty(); }
+	bool IsCompressed() const { return compressed; }
+	size_t Generation() const { return generation; }
+
+	/// Switch the storage of an empty pool
+	void SetCompressed(bool on)
+	{
+		assert(empty());
+		compressed = on;
+	}
+
+	/// Remove all sets, the storage mode is kept
+	void clear()
+	{
+		nodes.clear();
+		packed.clear();
+		offsets.assign(1, 0);
+		labels.clear();
+		nodeCount = 0;
+		++generation;
+	}
+
+	void reserve(size_t setCount, size_t nodeCount)
+	{
+		offsets.reserve(setCount + 1);
+		if (!compressed) nodes.reserve(nodeCount);
+	}
+
+	/// Append one set
+	template <class TIter>
+	void Append(TIter first, TIter last)
+	{
+		assert(labels.empty());
+		AppendSet(first, last);
+	}
+
+	/// Append one labelled set
+	template <class TIter>
+	void Append(TIter first, TIter last, int label)
+	{
+		assert(labels.size() == size());
+		AppendSet(first, last);
+		labels.push_back(label);
+	}
+
+	void push_back(const std::vector<int>& RR)
+	{
+		Append(RR.begin(), RR.end());
+	}
+
+	RRSpan operator[] (size_t i) const
+	{
+		if (compressed) {
+			return RRSpan(packed.data() + offsets[i]);
+		}
+		const int* base = nodes.data();
+		return RRSpan(base + offsets[i], base + offsets[i + 1]);
+	}
+
+	/// Label of set i (0 for unlabelled pools)
+	int Label(size_t i) const
+	{
+		return labels.empty() ? 0 : labels[i];
+	}
+
+	/// Memory held by the pool, in bytes
+	size_t MemoryBytes() const
+	{
+		return nodes.capacity() * sizeof(int) + packed.capacity() + offsets.capacity() * sizeof(size_t) + labels.capacity() * sizeof(int);
+	}
+
+	/// Append all parts in order and release them. The parts must use the storage mode of this pool.
+	/// A prefix sum over the part sizes gives every part its own output range, so parts are copied in parallel.
+	void Concat(std::vector<RRPool>& parts)
+	{
+		int nParts = (int)parts.size();
+		size_t dataSize = compressed ? packed.size() : nodes.size();
+		std::vector<size_t> setBase(nParts + 1, size());
+		std::vector<size_t> dataBase(nParts + 1, dataSize);
+		bool withLabels = false;
+		for (int p = 0; p < nParts; ++p) {
+			assert(parts[p].compressed == compressed);
+			setBase[p + 1] = setBase[p] + parts[p].size();
+			dataBase[p + 1] = dataBase[p] + (compressed ? parts[p].packed.size() : parts[p].nodes.size());
+			withLabels = withLabels || parts[p].HasLabels();
+			nodeCount += parts[p].nodeCount;
+		}
+		assert(!withLabels || labels.size() == size());
+		if (compressed) packed.resize(dataBase[nParts]);
+		else nodes.resize(dataBase[nParts]);
+		offsets.resize(setBase[nParts] + 1);
+		if (withLabels) labels.resize(setBase[nParts]);
+
+#pragma omp parallel for
+		for (int p = 0; p < nParts; ++p) {
+			RRPool& part = parts[p];
+			if (compressed) {
+				std::copy(part.packed.begin(), part.packed.end(), packed.begin() + dataBase[p]);
+			}
+			else {
+				std::copy(part.nodes.begin(), part.nodes.end(), nodes.begin() + dataBase[p]);
+			}
+			for (size_t i = 0; i < part.size(); ++i) {
+				offsets[setBase[p] + i + 1] = dataBase[p] + part.offsets[i + 1];
+			}
+			if (withLabels) {
+				std::copy(part.labels.begin(), part.labels.end(), labels.begin() + setBase[p]);
+			}
+			part.clear();
+			part.nodes.shrink_to_fit();
+			part.packed.shrink_to_fit();
+			part.offsets.shrink_to_fit();
+			part.labels.shrink_to_fit();
+		}
+	}
+};
+
+
+#endif // rr_pool_h__
@@ -0,0 +1,91 @@
+#include "world_cache.h"
+
+using namespace std;
+
+
+namespace {
+	/// working space of the calling thread, so that Run may be called from several threads at once
+	BatchTraversalScratch& ThreadScratch()
+	{
+		static thread_local BatchTraversalScratch scratch;
+		return scratch;
+	}
+}
+
+
+void WorldCache::Build(Graph& gf, int worldCount)
+{
+	this->gf = &gf;
+	this->worldCount = worldCount;
+	int nGroups = (worldCount + GROUP_SIZE - 1) / GROUP_SIZE;
+	live.assign(nGroups, vector<uint64_t>());
+	unsigned long long key = MIRandom::StreamSeed(MIRandom::WORLD_STREAMS, streamKey);
+
+#pragma omp parallel for schedule(dynamic) if(isConcurrent)
+	for (int g = 0; g < nGroups; g++) {
+		MIRandom groupRandom(MIRandom::StreamSeed(key, g));
+		uint64_t worlds = _Worlds(g);
+		vector<uint64_t>& masks = live[g];
+		masks.resize(gf.edges.size());
+		for (size_t e = 0; e < gf.edges.size(); e++) {
+			uint32_t th = gf.edges[e].th1;
+			uint64_t mask = 0;
+			if (th == MIRandom::ALWAYS_ACCEPT) {
+				mask = worlds;
+			}
+			else {
+				for (uint64_t bits = worlds; bits != 0; bits &= bits - 1) {
+					if (groupRandom.RandAccept(th)) mask |= 1ULL << LowestBitIndex(bits);
+				}
+			}
+			masks[e] = mask;
+		}
+	}
+}
+
+long long WorldCache::_Activate(int g, uint64_t worlds, int size, const int set[], BatchTraversalScratch& scratch) const
+{
+	const vector<uint64_t>& masks = live[g];
+	scratch.Reset(gf->n);
+	for (int i = 0; i < size; i++) {
+		uint64_t fresh = worlds & ~scratch.reached[set[i]];
+		if (fresh != 0) scratch.Reach(set[i], fresh);
+	}
+
+	long long result = 0;
+	for (size_t h = 0; h < scratch.queue.size(); h++)
+	{
+		int u = scratch.queue[h];
+		uint64_t mask = scratch.pending[u];
+		scratch.pending[u] = 0;
+		// out-edges of u are edges[first ... first + k), see GraphT::GetEdge
+		int first = (u == 0) ? 0 : gf->index[u - 1] + 1;
+		int k = gf->GetNeighborCount(u);
+		for (int i = 0; i < k; i++)
+		{
+			int v = gf->edges[first + i].v;
+			uint64_t hits = mask & masks[first + i] & ~scratch.reached[v];
+			if (hits != 0) scratch.Reach(v, hits);
+		}
+	}
+	for (int v : scratch.touched) {
+		result += BitCount(scratch.reached[v]);
+	}
+	return result;
+}
+
+double WorldCache::Run(int num_iter, int size, int set[])
+{
+	if (gf == NULL) {
+		throw NullPointerException("Please Build the worlds first. (gf==NULL)");
+	}
+
+	int count = (num_iter > 0 && num_iter < worldCount) ? num_iter : worldCount;
+	int nGroups = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+	long long resultSize = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:resultSize) if(isConcurrent && nGroups > 1)
+	for (int g = 0; g < nGroups; g++) {
+		resultSize += _Activate(g, _Worlds(g, count), size, set, ThreadScratch());
+	}
+	return (double)resultSize / (double)count;
+}